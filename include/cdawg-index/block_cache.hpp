@@ -0,0 +1,107 @@
+#ifndef INCLUDED_CDAWG_INDEX_BLOCK_CACHE
+#define INCLUDED_CDAWG_INDEX_BLOCK_CACHE
+
+#include <atomic>
+#include <cstdint>  // uint64_t
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "cdawg-index/cfg.hpp"
+
+namespace cdawg_index {
+
+/**
+ * A thread-safe cache of decoded text blocks for extracting snippets.
+ *
+ * The text is split into fixed-size blocks that are decoded from the grammar
+ * on demand. The most recently used blocks are kept, so snippets from nearby
+ * regions of the text reuse decoded blocks instead of decoding them again.
+ * Blocks are shared with readers so they stay valid after being evicted.
+ *
+ * The blocks store each character's rank in the grammar's alphabet in 2 bits
+ * for alphabets of up to 4 characters, e.g. DNA, or 4 bits for up to 16
+ * characters, e.g. DNA with N, so more of the text fits in the same memory.
+ * Larger alphabets use a byte per character. The characters are packed into
+ * words from the least significant bits.
+ */
+class BlockCache
+{
+
+public:
+
+    typedef std::shared_ptr<const std::vector<uint64_t>> Block;
+
+private:
+
+    static const int DEFAULT_BLOCK_SIZE = 1024;
+    static const int DEFAULT_CAPACITY = 256;
+
+    const CFG* cfg;
+    std::string alphabet;
+    unsigned char ranks[256];  // each character's rank in the alphabet
+    int width;  // the bits per character, which divides a word
+    int perWord;  // the characters per word
+    int blockSize;
+    size_t capacity;  // the number of blocks kept
+
+    // the blocks are ordered from most to least recently used
+    std::mutex mutex;
+    std::list<int> order;
+    std::unordered_map<int, std::pair<Block, std::list<int>::iterator>> blocks;
+
+    std::atomic<uint64_t> hits;
+    std::atomic<uint64_t> misses;
+
+    Block decode(int b) const;
+
+public:
+
+    /**
+     * Creates an empty cache for a grammar.
+     *
+     * @param cfg The grammar whose text is cached.
+     * @param blockSize The number of characters in a block.
+     * @param capacity The number of blocks to keep.
+     */
+    BlockCache(const CFG* cfg, int blockSize = DEFAULT_BLOCK_SIZE, int capacity = DEFAULT_CAPACITY);
+
+    /**
+     * Gets a decoded block, decoding it if it isn't cached.
+     *
+     * @param b The block number, i.e. the text position of its first character
+     * divided by the block size.
+     * @return The words of the packed ranks of the block's characters in the
+     * alphabet.
+     */
+    Block getBlock(int b);
+
+    /**
+     * Extracts a substring of the text.
+     *
+     * @param pos The text position of the substring.
+     * @param length The length of the substring.
+     * @return The substring, clipped to the text.
+     */
+    std::string extract(int pos, int length);
+
+    /**
+     * Extracts the text surrounding a position, e.g. to show a query hit.
+     *
+     * @param pos The text position.
+     * @param before The number of characters before the position to extract.
+     * @param after The number of characters from the position on to extract.
+     * @return The text from pos - before to pos + after, clipped to the text.
+     */
+    std::string extractContext(int pos, int before, int after);
+
+    int getBlockSize() const { return blockSize; }
+    uint64_t getHits() const { return hits.load(std::memory_order_relaxed); }
+    uint64_t getMisses() const { return misses.load(std::memory_order_relaxed); }
+
+};
+
+}
+
+#endif
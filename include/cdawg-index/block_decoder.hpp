@@ -0,0 +1,90 @@
+#ifndef INCLUDED_CDAWG_INDEX_BLOCK_DECODER
+#define INCLUDED_CDAWG_INDEX_BLOCK_DECODER
+
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "cdawg-index/cfg.hpp"
+
+namespace cdawg_index {
+
+/**
+ * Decodes a grammar's text on a producer thread ahead of a consumer.
+ *
+ * The text is decoded in fixed-size blocks into a single-producer/single-consumer
+ * ring. The consumer takes the blocks in order and the most recently taken
+ * blocks are kept in the ring, so characters near the consumer's frontier can be
+ * read from the ring instead of being decoded from the grammar again.
+ */
+class BlockDecoder
+{
+
+private:
+
+    static const int DEFAULT_BLOCK_SIZE = 4096;
+    static const int DEFAULT_NUM_BLOCKS = 64;
+
+    const CFG* cfg;
+    int begin;  // the text position of the first block
+    int blockSize;
+    int numBlocks;
+    int keepBlocks;  // how many taken blocks are kept readable
+    std::vector<char> ring;
+
+    // blocks are counted from the first block; produced is written by the
+    // producer and released by the consumer
+    std::atomic<int> produced;
+    std::atomic<int> released;
+    std::atomic<bool> stopped;
+    int taken;  // only used by the consumer
+    int windowBegin;  // the first text position that's still in the ring
+
+    std::thread producer;
+
+    void produce();
+
+public:
+
+    /**
+     * Starts decoding the text on a producer thread.
+     *
+     * @param cfg The grammar to decode.
+     * @param pos The text position to start decoding from.
+     * @param blockSize The number of characters in a block.
+     * @param numBlocks The number of blocks in the ring.
+     */
+    BlockDecoder(const CFG* cfg, int pos, int blockSize = DEFAULT_BLOCK_SIZE, int numBlocks = DEFAULT_NUM_BLOCKS);
+    ~BlockDecoder();
+
+    /**
+     * Takes the next block of decoded text, waiting for it to be decoded.
+     *
+     * @param length Set to the number of characters in the block.
+     * @return The block or NULL if the whole text has been taken.
+     */
+    const char* next(int& length);
+
+    /**
+     * Gets the character in the given position in the text.
+     *
+     * Positions in blocks that are still in the ring are read from the ring
+     * and other positions are decoded from the grammar. Must only be called by
+     * the consumer for positions in blocks that were already taken.
+     *
+     * @param q The position in the text.
+     * @return The character.
+     */
+    char get(int q) const
+    {
+        if (q >= windowBegin) {
+            int b = (q - begin) / blockSize;
+            return ring[(b % numBlocks) * blockSize + (q - begin) % blockSize];
+        }
+        return cfg->get(q);
+    }
+
+};
+
+}
+
+#endif
@@ -1,12 +1,17 @@
 #ifndef INCLUDED_CDAWG_INDEX_CDAWG
 #define INCLUDED_CDAWG_INDEX_CDAWG
 
+#include <cstdio>
+#include <limits>
+#include <map>
 #include <string>
 #include <tuple>
-#include <unordered_map>
 #include <utility>  // std::pair, std::make_pair
 #include <vector>
+#include "cdawg-index/block_decoder.hpp"
 #include "cdawg-index/cfg.hpp"
+#include "cdawg-index/char_map.hpp"
+#include "cdawg-index/pattern.hpp"
 
 #include <set>
 
@@ -16,20 +21,82 @@ namespace cdawg_index {
 class CDAWG
 {
 
+friend class PackedCDAWG;
+
+public:
+
+    // how the text is read during construction
+    enum Construction {
+        DECODED,  // decode the text on the constructing thread
+        PIPELINED,  // decode the text on a producer thread ahead of the construction
+        GRAMMAR  // traverse the grammar, indexing repeated rule expansions at once
+    };
+
 private:
 
-    const CFG* cfg;
+    // how many edge label characters are decoded per class test, which is
+    // small so a mismatch stops the decoding early
+    static constexpr int SEARCH_BLOCK_SIZE = 8;
+
+    // the end of edges to the sink, which grow as characters are added
+    static constexpr int OPEN_END = std::numeric_limits<int>::max();
+
+    CFG* cfg;  // extended in place by append
+
+    Construction construction;
+    BlockDecoder* window = NULL;
 
     class Node;
     typedef std::pair<Node*, int> NodeAndPos;
+    typedef std::tuple<int, int, Node*> Edge;
+    typedef CharMap<Edge> Edges;
 
-    int sid_count = 0;
+    int sid_count = 0;  // the number of nodes created
     Node* source;
     Node* sink;
     Node* bt;  // bottom node
 
+    // construction state, i.e. the active point after the last character was
+    // added and how many characters of the text have been indexed
+    NodeAndPos activePoint;
+    int textLength = 0;
+    bool counted = false;
+
+    // the non-terminal characters whose first occurrence was expanded by the
+    // grammar construction, which grows with the rules when appending
+    std::vector<bool> expanded;
+
+    // suffixes of the text that end at a node
+    std::set<Node*> suffixNodes;
+
+    // suffixes of the text that end inside an edge, i.e. the edge's source
+    // node and first character mapped to the depth of the suffix on the edge
+    std::multimap<std::pair<Node*, char>, int> suffixEdges;
+
+    // external memory, i.e. when the nodes' edges exceed the memory limit the
+    // edges of nodes that weren't used recently are spilled to a node file and
+    // loaded again when they're used
+    static constexpr size_t EDGE_BYTES = sizeof(Edges::value_type);
+    size_t memoryLimit;
+    mutable std::FILE* nodeFile = NULL;
+    mutable long nodeFileSize = 0;
+    mutable std::vector<Node*> resident;  // nodes with edges in memory
+    mutable size_t clockHand = 0;
+    mutable size_t residentEdges = 0;
+
+    Edges& edges(Node* n) const;
+    void setEdge(Node* s, char c, int k, int p, Node* n);
+    Node* newNode(Node* n = NULL);
+    void load(Node* n) const;
+    void spill(Node* n) const;
+    void enforceMemoryLimit() const;
+
     // indexing
     void buildIndex();
+    void buildFromGrammar(NodeAndPos& sk, int& i);
+    bool fastForward(NodeAndPos& sk, int p, int m);
+    NodeAndPos extend(NodeAndPos sk, int i, char c);
+    char charAt(int q) const { return (window != NULL) ? window->get(q) : cfg->get(q); }
     NodeAndPos update(Node* s, int k, int p, char c);
     bool check_end_point(Node* s, int k, int p, char c);
     Node* extension(Node* s, int k, int p);
@@ -38,19 +105,196 @@ private:
     NodeAndPos separate_node(Node* s, int k, int p);
     NodeAndPos canonize(Node* s, int k, int p);
 
-    void printNodes(Node* n, std::set<std::string>& visited);
+    // counting
+    void countOccurrences();
+    void countNodes(Node* n, std::set<Node*>& visited);
+    typedef std::map<Node*, std::vector<std::pair<int, int>>> DocumentCounts;
+    const std::vector<std::pair<int, int>>& countDocuments(Node* n, DocumentCounts& memo);
+    bool locate(const std::string& pattern, Node*& n, char& c, int& j);
+    int countOnEdge(Node* n, char c, int j);
+
+    // the minimal unique substrings as (text position, length) pairs sorted by
+    // position, which are found when they're first used
+    std::vector<std::pair<int, int>> uniques;
+    const std::vector<std::pair<int, int>>& minimalUniques();
+
+    // batch searching, i.e. the state of a query that's at node n or, if it's
+    // on an edge, about to match the edge's label from pattern position i
+    static constexpr int DEFAULT_GROUP_SIZE = 8;
+    struct BatchQuery
+    {
+        size_t q;
+        Node* n;
+        std::string::size_type i;
+        bool onEdge;
+        int k, p;
+        Node* m;
+    };
+    bool advance(BatchQuery& query, const std::string& pattern, bool& found);
+    bool matchLabel(int& k, int p, const std::string& pattern, std::string::size_type& i) const;
+
+    // searching
+    bool searchNode(Node* n, const Pattern& pattern, int i);
+    bool searchEdge(const Edge& e, const Pattern& pattern, int i);
+
+    std::string nodeName(const Node* n) const;
+    void printNodes(Node* n, std::set<Node*>& visited);
 
     void deleteNodes(Node* n, std::set<Node*>& visited);
+    size_t sizeNodes(Node* n, std::set<Node*>& visited);
 
 public:
 
-    CDAWG(const CFG* cfg);
+    /**
+     * Builds a CDAWG for the text of a grammar.
+     *
+     * @param cfg The grammar to index. It must outlive the CDAWG and is
+     * extended by append.
+     * @param construction How the text is read. GRAMMAR computes the grammar's
+     * fingerprints and takes time that scales with the grammar's size rather
+     * than the text length on repetitive texts.
+     * @param memoryLimit The number of bytes the nodes' edges may use before
+     * they're spilled to disk, or 0 to keep every node in memory.
+     */
+    CDAWG(CFG* cfg, Construction construction = DECODED, size_t memoryLimit = 0);
     ~CDAWG();
 
+    /**
+     * Appends the text of another grammar to the indexed grammar and indexes
+     * it, resuming the online construction from the saved active point.
+     * The time is proportional to the appended grammar and text; the
+     * occurrence counts are recomputed the next time they're used.
+     *
+     * @param extra The grammar to append. It's copied and can be deleted
+     * afterwards.
+     */
+    void append(const CFG* extra);
+
     bool search(const std::string& pattern);
 
+    /**
+     * Searches for a batch of patterns by interleaving them on one thread.
+     *
+     * Each query in a group advances one node or edge at a time in round-robin
+     * order and prefetches the next node it will visit before yielding to the
+     * next query, so the memory latency of one query is hidden by the work of
+     * the others.
+     *
+     * @param patterns The patterns to search for.
+     * @param groupSize The number of queries that are interleaved.
+     * @return Whether each pattern occurs in the text.
+     */
+    std::vector<bool> search(const std::vector<std::string>& patterns, int groupSize = DEFAULT_GROUP_SIZE);
+
+    /**
+     * Searches for a pattern that may contain wildcards and character classes.
+     *
+     * @param pattern The compiled pattern.
+     * @return Whether some substring of the text matches the pattern.
+     */
+    bool search(const Pattern& pattern);
+
+    /**
+     * Counts the occurrences of a pattern in the text.
+     *
+     * @param pattern The pattern to count.
+     * @return The number of occurrences.
+     */
+    int count(const std::string& pattern);
+
+    /**
+     * Lists the documents that contain a pattern.
+     *
+     * The occurrences are counted per document over the sub-DAG below the
+     * pattern's locus, so the occurrences themselves are not visited and the
+     * nodes don't store per-document counts.
+     *
+     * @param pattern The pattern to list the documents of.
+     * @return The document indexes that contain the pattern, in ascending
+     * order, paired with the number of occurrences in each document.
+     */
+    std::vector<std::pair<int, int>> documents(const std::string& pattern);
+
+    /**
+     * Lists the maximal repeats of the text, i.e. the strings of the CDAWG's
+     * internal nodes that occur more than once.
+     *
+     * The nodes are visited once and their lengths and occurrence counts are
+     * stored in the nodes, so the time is proportional to the size of the
+     * CDAWG rather than the text. The repeats' text isn't decoded. Since the
+     * text has no unique terminator, the end of the text doesn't count as a
+     * distinct right extension of a repeat.
+     *
+     * @param minLength The shortest repeat to list.
+     * @param k The number of repeats to list, or 0 to list all of them.
+     * @param longest Whether to list the longest repeats rather than the most
+     * frequent ones.
+     * @return The (text position, length, number of occurrences) of the
+     * repeats, from the most frequent or longest.
+     */
+    std::vector<std::tuple<int, int, int>> repeats(int minLength, int k = 0, bool longest = false);
+
+    /**
+     * Finds the shortest substring that covers a text position and occurs
+     * exactly once in the text.
+     *
+     * @param pos The text position.
+     * @return The (text position, length) of the shortest unique substring, the
+     * leftmost one if there are several.
+     * @throws std::runtime_error if the position is outside the text.
+     */
+    std::pair<int, int> shortestUnique(int pos);
+
+    /**
+     * Finds the shortest unique substrings that cover each position of a range
+     * of the text.
+     *
+     * Every unique substring contains a minimal unique substring, i.e. one whose
+     * proper substrings all occur more than once, and these are found once from
+     * the lengths and occurrence counts of the nodes with edges to the sink, so
+     * the time is proportional to the size of the CDAWG plus the range.
+     *
+     * @param pos The text position of the range.
+     * @param length The number of positions in the range.
+     * @return The (text position, length) of each position's shortest unique
+     * substring, the leftmost one if there are several.
+     * @throws std::runtime_error if the range is outside the text.
+     */
+    std::vector<std::pair<int, int>> shortestUnique(int pos, int length);
+
+    /**
+     * Lists the minimal absent words of the text, i.e. the strings that don't
+     * occur in the text but whose proper substrings all do.
+     *
+     * A minimal absent word is a·x·b where x is the longest string in the
+     * suffix link target of the state of a·x in the text's DAWG. The states are
+     * the CDAWG's nodes and the positions inside its edges, and the targets are
+     * found by following the nodes' suffix links and reading the edge labels
+     * from them, so the time is proportional to the size of the CDAWG plus the
+     * words. The words are over the text's alphabet, so they have at least two
+     * characters.
+     *
+     * @param maxLength The longest word to list.
+     * @return The words, in no particular order.
+     */
+    std::vector<std::string> absentWords(int maxLength);
+
     void printGraph();
 
+    /**
+     * Estimates the memory used by the CDAWG's nodes and edges.
+     *
+     * @return The estimated number of bytes.
+     */
+    size_t sizeInBytes();
+
+    /**
+     * Gets the size of the node file that spilled edges are written to.
+     *
+     * @return The number of bytes, or 0 if no edges were spilled.
+     */
+    size_t spilledBytes() const { return nodeFileSize; }
+
 };
 
 /** A Node in the CDAWG. */
@@ -59,18 +303,40 @@ class CDAWG::Node
 
 public:
 
-    std::string id;
+    // NOTE: the members are ordered so they pack without padding
     Node* suf;
+    Edges to;
+    int id;  // the nodes are numbered in the order they're created
     int len;
-    std::unordered_map<char, std::tuple<int, int, Node*>> to;
+    int count;  // number of occurrences
 
-    Node(std::string id);
-    Node(std::string id, Node& n);
+    // paging state when the CDAWG has a memory limit
+    bool used = false;
+    bool spilled = false;
+    int spillSize = 0;
+    int spillCapacity = 0;
+    long spillOffset = 0;
+
+    Node(int id);
+    Node(int id, Node& n);
 
     void edge(char c, int k, int p, Node* n);
 
 };
 
+/** Gets a node's edges, loading them from the node file if they were spilled. */
+inline CDAWG::Edges& CDAWG::edges(Node* n) const
+{
+    if (n->spilled) {
+        load(n);
+    }
+    // only the clock algorithm reads this, so reads don't write without a limit
+    if (memoryLimit > 0) {
+        n->used = true;
+    }
+    return n->to;
+}
+
 }
 
 #endif
@@ -1,11 +1,13 @@
 #ifndef INCLUDED_CDAWG_INDEX_CFG
 #define INCLUDED_CDAWG_INDEX_CFG
 
+#include <cstdint>  // uint64_t
 #include <functional>  // std::greater
 #include <iterator>  // std::forward_iterator_tag
 #include <map>
 #include <stack>
 #include <string>
+#include <vector>
 
 namespace cdawg_index {
 
@@ -21,18 +23,59 @@ private:
     static const int MR_REPAIR_CHAR_SIZE = 256;
     static const int MR_REPAIR_DUMMY_CODE = -1;  // UINT_MAX in MR-RePair C code
 
+    // every RULE_SAMPLE_RATE-th character of a rule is an entry point
+    static const int RULE_SAMPLE_RATE = 16;
+
     // NOTE: key order is reversed for finding nearest key that is <=
     std::map<int, int, std::greater<int>> startIndex;
 
-    int textLength;
-    int numRules;
-    int startSize;
-    int rulesSize;
-    int** rules;
-    int startRule;
+    int textLength = 0;
+    int numRules = 0;
+    int startSize = 0;
+    int rulesSize = 0;
+    int** rules = NULL;
+    int* ruleSizes = NULL;  // the length of each (non-)terminal character's expansion
+    int startRule = 0;
+
+    // the allocated lengths of rules and ruleSizes and of the start rule when
+    // they were grown by appending, or 0 if they're exactly as long as needed
+    int rulesCapacity = 0;
+    int startCapacity = 0;
+
+    // text positions of the separators between the documents of a collection
+    std::vector<int> separators;
+    char separator;
+
+    std::string alphabet;  // the characters of the text in ascending order
+
+    // the expansion offsets of the entry points in long rules; the entry points
+    // of rule r are samples[sampleBegin[r]] up to samples[sampleBegin[r + 1]]
+    std::vector<int> sampleBegin;
+    std::vector<int> samples;
+
+    // Karp-Rabin fingerprints modulo 2^61 - 1 with a random base, which are
+    // only computed when they're requested: the fingerprint and the base power
+    // of each (non-)terminal character's expansion, of the start rule's
+    // prefixes, and of the rule prefixes that end at the entry points
+    uint64_t fingerprintBase = 0;
+    std::vector<uint64_t> symbolFingerprints;
+    std::vector<uint64_t> symbolPowers;
+    std::vector<uint64_t> startFingerprints;
+    std::vector<uint64_t> sampleFingerprints;
+
+    static int* copyRule(const int* rule, int ruleOffset);
+    void sampleRules(int first = MR_REPAIR_CHAR_SIZE);
+    void findAlphabet(int firstRule = MR_REPAIR_CHAR_SIZE, int firstStart = 0);
+    void fingerprintRules(int firstRule = MR_REPAIR_CHAR_SIZE, int firstStart = 0);
+    int entryPoint(int r, int& offset) const;
+    uint64_t power(int length) const;
+    uint64_t prefixFingerprint(int q) const;
 
 public:
 
+    // ends the characters of every rule
+    static const int RULE_END = MR_REPAIR_DUMMY_CODE;
+
     CFG();
     ~CFG();
 
@@ -55,11 +98,123 @@ public:
      */
     static CFG* fromNavarroFiles(std::string filenameC, std::string filenameR);
 
+    /**
+     * Concatenates a collection of grammars into a single grammar.
+     *
+     * Each grammar is a document and consecutive documents are separated by a
+     * character that doesn't occur in any of the grammars. The given grammars
+     * are copied and can be deleted afterwards.
+     *
+     * @param cfgs The grammars of the documents in the collection.
+     * @return The grammar of the collection.
+     * @throws Exception if the grammars use every character.
+     */
+    static CFG* fromCollection(const std::vector<CFG*>& cfgs);
+
+    /**
+     * Appends the text of another grammar to the end of this grammar's text.
+     *
+     * The other grammar's rules are copied after this grammar's rules and its
+     * start rule symbols are added to the end of this grammar's start rule.
+     * The rules and the start rule grow by doubling and only the new rules are
+     * sampled and scanned for new characters, so the amortized time is
+     * proportional to the size of the other grammar.
+     *
+     * @param cfg The grammar to append.
+     */
+    void append(const CFG* cfg);
+
+    /**
+     * Rebalances the grammar so its height is logarithmic in the text length.
+     *
+     * Every rule is replaced by binary rules that form an AVL tree, using
+     * Rytter's construction. The start rule keeps its (non-)terminal
+     * characters, each replaced by its balanced equivalent, so the text and the
+     * text positions of the start rule characters don't change.
+     */
+    void rebalance();
+
+    /**
+     * Gets the height of the grammar.
+     *
+     * @return The most rules that are descended from the start rule to reach a
+     * terminal character, including the start rule.
+     */
+    int getHeight() const;
+
     int getTextLength() const { return textLength; }
     int getNumRules() const { return numRules; }
     int getStartSize() const { return startSize; }
     int getRulesSize() const { return rulesSize; }
     int getTotalSize() const { return startSize + rulesSize; }
+    int getNumDocuments() const { return separators.size() + 1; }
+    char getSeparator() const { return separator; }
+    const std::string& getAlphabet() const { return alphabet; }
+
+    /**
+     * Gets the characters of a rule, e.g. to traverse the grammar instead of
+     * decoding its text.
+     *
+     * @param c A non-terminal character or the start rule.
+     * @return The rule's (non-)terminal characters, ended by RULE_END.
+     */
+    const int* getRule(int c) const { return rules[c]; }
+    int getStartRule() const { return startRule; }
+    static bool isTerminal(int c) { return c < MR_REPAIR_CHAR_SIZE; }
+
+    /**
+     * @param c A (non-)terminal character.
+     * @return The length of the character's expansion.
+     */
+    int getExpansionLength(int c) const { return ruleSizes[c]; }
+
+    /**
+     * Gets the index in the start rule of the character whose expansion
+     * contains the given position in the text.
+     *
+     * @param q The position in the text.
+     * @return The index, or the length of the start rule if q is the text
+     * length.
+     */
+    int getStartIndex(int q) const;
+
+    /**
+     * Computes the fingerprints used by getFingerprint, in time proportional
+     * to the grammar's size. Appending and rebalancing keep them up to date.
+     */
+    void computeFingerprints();
+
+    /**
+     * Gets the Karp-Rabin fingerprint of a substring of the text, so
+     * substrings can be compared without decoding them. Different substrings
+     * have the same fingerprint with probability about length / 2^61.
+     *
+     * The time is proportional to the grammar's height and the logarithm of
+     * the length. computeFingerprints must have been called.
+     *
+     * @param q The first position of the substring.
+     * @param length The length of the substring.
+     * @return The fingerprint.
+     */
+    uint64_t getFingerprint(int q, int length) const;
+
+    /**
+     * Gets the document that contains the given position in the text.
+     *
+     * @param q The position in the text.
+     * @return The index of the document. A separator belongs to the document
+     * that follows it.
+     */
+    int getDocument(int q) const;
+
+    /**
+     * Counts the document separators in a range of the text.
+     *
+     * @param k The first position of the range.
+     * @param p The last position of the range.
+     * @return The number of separators in positions k through p.
+     */
+    int countSeparators(int k, int p) const;
 
     /**
      * Gets the character in the given position in the text.
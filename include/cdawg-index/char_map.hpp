@@ -0,0 +1,88 @@
+#ifndef INCLUDED_CDAWG_INDEX_CHAR_MAP
+#define INCLUDED_CDAWG_INDEX_CHAR_MAP
+
+#include <algorithm>
+#include <cstddef>  // size_t
+#include <utility>  // std::pair
+#include <vector>
+
+namespace cdawg_index {
+
+/**
+ * A map from characters to values that's stored as an array sorted by the
+ * characters.
+ *
+ * The entries are in one heap-allocated vector whatever the alphabet. Maps over
+ * small alphabets, e.g. the 4-5 characters of DNA, are searched linearly
+ * instead of hashing; larger maps are binary searched. Inserting is linear in
+ * the size of the map.
+ */
+template <class T>
+class CharMap
+{
+
+public:
+
+    typedef std::pair<char, T> value_type;
+    typedef typename std::vector<value_type>::iterator iterator;
+    typedef typename std::vector<value_type>::const_iterator const_iterator;
+
+private:
+
+    // the largest map that's searched linearly
+    static const size_t LINEAR_SEARCH_SIZE = 8;
+
+    std::vector<value_type> entries;
+
+    static bool less(const value_type& e, char c) { return (unsigned char) e.first < (unsigned char) c; }
+
+    template <class It>
+    static It find(It first, It last, char c)
+    {
+        if (last - first <= (std::ptrdiff_t) LINEAR_SEARCH_SIZE) {
+            for (; first != last; ++first) {
+                if (first->first == c) {
+                    return first;
+                }
+            }
+            return last;
+        }
+        It itr = std::lower_bound(first, last, c, less);
+        return (itr != last && itr->first == c) ? itr : last;
+    }
+
+public:
+
+    iterator begin() { return entries.begin(); }
+    iterator end() { return entries.end(); }
+    const_iterator begin() const { return entries.begin(); }
+    const_iterator end() const { return entries.end(); }
+
+    size_t size() const { return entries.size(); }
+    bool empty() const { return entries.empty(); }
+    const value_type* data() const { return entries.data(); }
+    size_t capacity() const { return entries.capacity(); }
+    void reserve(size_t n) { entries.reserve(n); }
+
+    /** Removes the entries and frees their memory. */
+    void clear() { std::vector<value_type>().swap(entries); }
+
+    iterator find(char c) { return find(entries.begin(), entries.end(), c); }
+    const_iterator find(char c) const { return find(entries.begin(), entries.end(), c); }
+    bool contains(char c) const { return find(c) != end(); }
+
+    /** Gets the value of a character, inserting a default value if it's missing. */
+    T& operator[](char c)
+    {
+        auto itr = std::lower_bound(entries.begin(), entries.end(), c, less);
+        if (itr == entries.end() || itr->first != c) {
+            itr = entries.insert(itr, value_type(c, T()));
+        }
+        return itr->second;
+    }
+
+};
+
+}
+
+#endif
@@ -0,0 +1,138 @@
+#ifndef INCLUDED_CDAWG_INDEX_PACKED_CDAWG
+#define INCLUDED_CDAWG_INDEX_PACKED_CDAWG
+
+#include <cstddef>  // size_t
+#include <cstdint>  // uint64_t
+#include <string>
+#include <vector>
+#include "cdawg-index/cdawg.hpp"
+#include "cdawg-index/cfg.hpp"
+
+namespace cdawg_index {
+
+/** An array of unsigned integers that are each stored in a fixed number of bits. */
+class PackedArray
+{
+
+private:
+
+    static const int WORD_SIZE = 64;
+
+    int length;
+    int width;
+    std::vector<uint64_t> words;
+
+public:
+
+    PackedArray();
+    PackedArray(int length, int width);
+
+    /**
+     * Gets the number of bits needed to store a value.
+     *
+     * @param max The largest value that will be stored.
+     * @return The number of bits, which is at least 1.
+     */
+    static int bitsFor(uint64_t max);
+
+    int size() const { return length; }
+    int getWidth() const { return width; }
+    size_t sizeInBytes() const { return words.size() * sizeof(uint64_t); }
+
+    uint64_t get(int i) const;
+    void set(int i, uint64_t value);
+
+};
+
+/** A bit vector that supports select queries on its set bits. */
+class BitVector
+{
+
+private:
+
+    static const int WORD_SIZE = 64;
+    static const int SAMPLE_RATE = 64;  // every SAMPLE_RATE-th set bit is sampled
+
+    int length;
+    std::vector<uint64_t> words;
+    // the word that contains each sampled set bit and the set bits before it
+    std::vector<int> samples;
+    std::vector<int> sampleRanks;
+
+public:
+
+    BitVector();
+
+    /**
+     * Builds a bit vector.
+     *
+     * @param bits The value of each bit.
+     */
+    BitVector(const std::vector<bool>& bits);
+
+    int size() const { return length; }
+    size_t sizeInBytes() const
+    {
+        return words.size() * sizeof(uint64_t) + 2 * samples.size() * sizeof(int);
+    }
+
+    bool get(int i) const { return (words[i / WORD_SIZE] >> (i % WORD_SIZE)) & 1; }
+
+    /**
+     * Finds the position of a set bit.
+     *
+     * @param j The rank of the set bit, starting from 0.
+     * @return The position of the j-th set bit.
+     */
+    int select(int j) const;
+
+};
+
+/**
+ * A read-only, bit-packed encoding of a CDAWG.
+ *
+ * The nodes are numbered from the source and the out-edges of each node are
+ * stored contiguously, sorted by their first character. A bit vector marks where
+ * each node's edges begin, the first characters are stored one byte per edge, and
+ * the edge labels and targets are stored in packed arrays whose widths are the
+ * fewest bits that fit the text length, the longest label, and the number of
+ * nodes, respectively.
+ */
+class PackedCDAWG
+{
+
+private:
+
+    const CFG* cfg;
+
+    int numNodes;
+    int sink;
+
+    // one set bit per node followed by an unset bit per out-edge
+    BitVector nodes;
+    std::vector<unsigned char> chars;
+    PackedArray starts;
+    PackedArray lengths;
+    PackedArray targets;
+
+public:
+
+    /**
+     * Encodes a CDAWG.
+     *
+     * @param cdawg The CDAWG to encode. It isn't needed after encoding but the
+     * CDAWG's grammar is.
+     */
+    PackedCDAWG(const CDAWG& cdawg);
+
+    int getNumNodes() const { return numNodes; }
+    int getNumEdges() const { return chars.size(); }
+    size_t sizeInBytes() const;
+
+    bool search(const std::string& pattern) const;
+
+};
+
+}
+
+#endif
@@ -0,0 +1,84 @@
+#ifndef INCLUDED_CDAWG_INDEX_PATTERN
+#define INCLUDED_CDAWG_INDEX_PATTERN
+
+#include <array>
+#include <cstdint>  // uint64_t
+#include <string>
+#include <vector>
+
+namespace cdawg_index {
+
+/**
+ * A compiled pattern that may contain wildcards and character classes.
+ *
+ * The syntax is that of a simple glob: "?" matches any character, "[...]"
+ * matches any character in the class (ranges like "a-z" are allowed and a
+ * leading "^" negates the class), "\" escapes the next character, and every
+ * other character matches itself.
+ */
+class Pattern
+{
+
+private:
+
+    static const int CHAR_SIZE = 256;
+    static const int WORD_SIZE = 64;
+    static const int CLASS_WORDS = CHAR_SIZE / WORD_SIZE;
+
+    typedef std::array<uint64_t, CLASS_WORDS> CharClass;
+
+    // one membership bit vector per pattern position
+    std::vector<CharClass> classes;
+    std::vector<std::string> members;
+
+    static void add(CharClass& cc, unsigned char c);
+
+public:
+
+    /**
+     * Compiles a pattern.
+     *
+     * @param pattern The pattern to compile.
+     * @throws Exception if the pattern is malformed.
+     */
+    Pattern(const std::string& pattern);
+
+    int size() const { return classes.size(); }
+
+    /**
+     * Gets the characters matched by the given position in the pattern.
+     *
+     * @param i The position in the pattern.
+     * @return The characters in the position's class in ascending order.
+     */
+    const std::string& getMembers(int i) const { return members[i]; }
+
+    /**
+     * Checks if a character matches the given position in the pattern.
+     *
+     * @param i The position in the pattern.
+     * @param c The character.
+     * @return Whether c is in the position's class.
+     */
+    bool matches(int i, char c) const
+    {
+        unsigned char u = (unsigned char) c;
+        return (classes[i][u / WORD_SIZE] >> (u % WORD_SIZE)) & 1;
+    }
+
+    /**
+     * Checks if a block of characters matches the pattern starting at the
+     * given position.
+     *
+     * @param i The position in the pattern the block is aligned to.
+     * @param block The characters to check.
+     * @param length The number of characters in the block.
+     * @return Whether every character matches its position's class.
+     */
+    bool matches(int i, const char* block, int length) const;
+
+};
+
+}
+
+#endif
@@ -0,0 +1,87 @@
+#ifndef INCLUDED_CDAWG_INDEX_PERF_COUNTERS
+#define INCLUDED_CDAWG_INDEX_PERF_COUNTERS
+
+#include <cstdint>  // uint64_t
+#include <string>
+
+namespace cdawg_index {
+
+/**
+ * Hardware performance counters of the calling process, e.g. to tell whether
+ * a phase of a benchmark is bound by cache misses or branch mispredictions.
+ *
+ * The counters are read with Linux's perf_event_open and only count user
+ * space. Each event is opened on its own, so events the CPU or kernel doesn't
+ * support are skipped; if the kernel multiplexes the events, the counts are
+ * scaled by the fraction of the time they were counted. On other systems, or
+ * if perf events aren't permitted, no counters are available.
+ */
+class PerfCounters
+{
+
+public:
+
+    enum Event {
+        CYCLES,
+        INSTRUCTIONS,
+        L1D_MISSES,
+        LLC_MISSES,
+        BRANCH_MISSES,
+        DTLB_MISSES,
+        NUM_EVENTS
+    };
+
+private:
+
+    int fds[NUM_EVENTS];  // -1 if the event isn't available
+    uint64_t values[NUM_EVENTS];
+    std::string error;  // why the first event couldn't be opened
+
+public:
+
+    /**
+     * Opens the counters, which are stopped.
+     */
+    PerfCounters();
+    ~PerfCounters();
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    /**
+     * Resets the counters and starts counting.
+     */
+    void start();
+
+    /**
+     * Stops counting and reads the counters.
+     */
+    void stop();
+
+    /**
+     * @return Whether any of the events can be counted.
+     */
+    bool available() const;
+
+    /**
+     * @return Whether the event can be counted.
+     */
+    bool available(Event e) const { return fds[e] != -1; }
+
+    /**
+     * @return The event's count between the last start and stop.
+     */
+    uint64_t get(Event e) const { return values[e]; }
+
+    /**
+     * @return Why the counters aren't available, or an empty string.
+     */
+    const std::string& getError() const { return error; }
+
+    static const char* getName(Event e);
+
+};
+
+}
+
+#endif
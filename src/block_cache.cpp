@@ -0,0 +1,101 @@
+#include <algorithm>
+#include <bit>  // std::bit_width
+#include "cdawg-index/block_cache.hpp"
+
+namespace cdawg_index {
+
+// construction
+
+BlockCache::BlockCache(const CFG* cfg, int blockSize, int capacity) :
+    cfg(cfg),
+    alphabet(cfg->getAlphabet()),
+    blockSize(blockSize),
+    capacity(std::max(capacity, 1)),
+    hits(0),
+    misses(0)
+{
+    for (size_t r = 0; r < alphabet.size(); r++) {
+        ranks[(unsigned char) alphabet[r]] = r;
+    }
+    // use a width that divides a word so characters are never split
+    int bits = std::bit_width(std::max(alphabet.size(), (size_t) 1) - 1);
+    width = (bits <= 2) ? 2 : (bits <= 4) ? 4 : 8;
+    perWord = 64 / width;
+}
+
+// blocks
+
+BlockCache::Block BlockCache::decode(int b) const
+{
+    int pos = b * blockSize;
+    int length = std::min(blockSize, cfg->getTextLength() - pos);
+    auto block = std::make_shared<std::vector<uint64_t>>((length + perWord - 1) / perWord, 0);
+    auto it = cfg->cbegin(pos);
+    for (int j = 0; j < length; ++j, ++it) {
+        (*block)[j / perWord] |= (uint64_t) ranks[(unsigned char) *it] << (j % perWord * width);
+    }
+    return block;
+}
+
+BlockCache::Block BlockCache::getBlock(int b)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto itr = blocks.find(b);
+        if (itr != blocks.end()) {
+            order.splice(order.begin(), order, itr->second.second);
+            hits.fetch_add(1, std::memory_order_relaxed);
+            return itr->second.first;
+        }
+    }
+
+    // decode without holding the lock so other threads can read the cache; if
+    // another thread decodes the same block first then its block is kept
+    misses.fetch_add(1, std::memory_order_relaxed);
+    Block block = decode(b);
+    std::lock_guard<std::mutex> lock(mutex);
+    auto itr = blocks.find(b);
+    if (itr != blocks.end()) {
+        order.splice(order.begin(), order, itr->second.second);
+        return itr->second.first;
+    }
+    if (blocks.size() == capacity) {
+        blocks.erase(order.back());
+        order.pop_back();
+    }
+    order.push_front(b);
+    blocks.emplace(b, std::make_pair(block, order.begin()));
+    return block;
+}
+
+// extraction
+
+std::string BlockCache::extract(int pos, int length)
+{
+    int begin = std::max(pos, 0);
+    int end = std::min(pos + length, cfg->getTextLength());
+    std::string text;
+    if (begin >= end) {
+        return text;
+    }
+    text.resize(end - begin);
+    char* out = text.data();
+    uint64_t mask = (((uint64_t) 1) << width) - 1;
+    for (int b = begin / blockSize; b * blockSize < end; b++) {
+        Block block = getBlock(b);
+        const uint64_t* words = block->data();
+        int first = std::max(begin - b * blockSize, 0);
+        int last = std::min(end - b * blockSize, blockSize);
+        for (int j = first; j < last; j++) {
+            *out++ = alphabet[(words[j / perWord] >> (j % perWord * width)) & mask];
+        }
+    }
+    return text;
+}
+
+std::string BlockCache::extractContext(int pos, int before, int after)
+{
+    return extract(pos - before, before + after);
+}
+
+}
@@ -0,0 +1,77 @@
+#include <algorithm>
+#include "cdawg-index/block_decoder.hpp"
+
+namespace cdawg_index {
+
+// construction
+
+BlockDecoder::BlockDecoder(const CFG* cfg, int pos, int blockSize, int numBlocks) :
+    cfg(cfg),
+    begin(pos),
+    blockSize(blockSize),
+    numBlocks(numBlocks),
+    keepBlocks(numBlocks / 2),
+    ring((size_t) blockSize * numBlocks),
+    produced(0),
+    released(0),
+    stopped(false),
+    taken(0),
+    windowBegin(pos)
+{
+    producer = std::thread(&BlockDecoder::produce, this);
+}
+
+// destruction
+
+BlockDecoder::~BlockDecoder()
+{
+    stopped.store(true, std::memory_order_release);
+    producer.join();
+}
+
+// producer
+
+void BlockDecoder::produce()
+{
+    int b = 0;
+    auto it = cfg->cbegin(begin), end = cfg->cend();
+    while (it != end) {
+        // wait for the consumer to release the slot
+        while (b - released.load(std::memory_order_acquire) == numBlocks) {
+            if (stopped.load(std::memory_order_acquire)) {
+                return;
+            }
+            std::this_thread::yield();
+        }
+        char* block = ring.data() + (size_t) (b % numBlocks) * blockSize;
+        for (int i = 0; i < blockSize && it != end; ++i, ++it) {
+            block[i] = *it;
+        }
+        produced.store(++b, std::memory_order_release);
+    }
+}
+
+// consumer
+
+const char* BlockDecoder::next(int& length)
+{
+    int textLength = cfg->getTextLength();
+    int pos = begin + taken * blockSize;
+    if (pos >= textLength) {
+        return NULL;
+    }
+    // keep a window of taken blocks and release the rest to the producer
+    if (taken - released.load(std::memory_order_relaxed) == keepBlocks) {
+        int r = released.load(std::memory_order_relaxed) + 1;
+        windowBegin = begin + r * blockSize;
+        released.store(r, std::memory_order_release);
+    }
+    // wait for the producer to decode the block
+    while (produced.load(std::memory_order_acquire) == taken) {
+        std::this_thread::yield();
+    }
+    length = std::min(blockSize, textLength - pos);
+    return ring.data() + (size_t) (taken++ % numBlocks) * blockSize;
+}
+
+}
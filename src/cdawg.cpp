@@ -1,6 +1,9 @@
 #include <algorithm>
+#include <cstring>
+#include <deque>
 #include <iostream>
 #include <fstream>
+#include <stdexcept>
 #include "cdawg-index/cdawg.hpp"
 #include "cdawg-index/cfg.hpp"
 
@@ -8,17 +11,24 @@ namespace cdawg_index {
 
 // construction
 
-CDAWG::CDAWG(const CFG* cfg) : cfg(cfg)
+CDAWG::CDAWG(CFG* cfg, Construction construction, size_t memoryLimit) :
+    cfg(cfg),
+    construction(construction),
+    memoryLimit(memoryLimit)
 {
-    bt = new Node("root");
+    if (construction == GRAMMAR) {
+        cfg->computeFingerprints();
+    }
+    bt = newNode();
     bt->len = -1;
 
-    source = new Node("source");
+    source = newNode();
     source->suf = bt;
     source->len = 0;
 
-    sink = new Node("sink");
-    
+    sink = newNode();
+
+    activePoint = std::make_pair(source, 0);
     buildIndex();
 }
 
@@ -30,7 +40,7 @@ void CDAWG::deleteNodes(Node* n, std::set<Node*>& visited)
         return;
     }
     visited.insert(n);
-    for (const auto &[key, value]: n->to) {
+    for (const auto &[key, value]: edges(n)) {
         deleteNodes(std::get<2>(value), visited);
     }
     delete n;
@@ -41,26 +51,158 @@ CDAWG::~CDAWG()
     Node* root = bt;
     std::set<Node*> visited;
     deleteNodes(root, visited);
+    if (nodeFile != NULL) {
+        std::fclose(nodeFile);
+    }
+}
+
+// external memory
+
+namespace {
+
+// a spilled edge is its first character, label, and target
+constexpr size_t RECORD_SIZE = sizeof(char) + 2 * sizeof(int) + sizeof(void*);
+
+}
+
+CDAWG::Node* CDAWG::newNode(Node* n)
+{
+    Node* r;
+    if (n == NULL) {
+        r = new Node(sid_count++);
+    } else {
+        edges(n);
+        r = new Node(sid_count++, *n);
+        residentEdges += r->to.size();
+    }
+    if (memoryLimit > 0) {
+        resident.push_back(r);
+    }
+    return r;
+}
+
+void CDAWG::setEdge(Node* s, char c, int k, int p, Node* n)
+{
+    Edges& to = edges(s);
+    size_t size = to.size();
+    s->edge(c, k, p, n);
+    residentEdges += to.size() - size;
+}
+
+void CDAWG::load(Node* n) const
+{
+    std::vector<char> buffer(n->spillSize * RECORD_SIZE);
+    if (!buffer.empty() && (std::fseek(nodeFile, n->spillOffset, SEEK_SET) != 0 ||
+        std::fread(buffer.data(), 1, buffer.size(), nodeFile) != buffer.size())) {
+        throw std::runtime_error("failed to read the node file");
+    }
+    n->to.reserve(n->spillSize);
+    char c;
+    int k, p;
+    Node* m;
+    for (const char* record = buffer.data(); record != buffer.data() + buffer.size(); record += RECORD_SIZE) {
+        c = record[0];
+        std::memcpy(&k, record + sizeof(char), sizeof(int));
+        std::memcpy(&p, record + sizeof(char) + sizeof(int), sizeof(int));
+        std::memcpy(&m, record + sizeof(char) + 2 * sizeof(int), sizeof(void*));
+        n->to[c] = {k, p, m};
+    }
+    n->spilled = false;
+    resident.push_back(n);
+    residentEdges += n->spillSize;
+}
+
+/**
+* Writes a node's edges to the node file and frees them. The edges are written
+* over the node's previous edges if they fit, otherwise at the end of the file.
+*/
+void CDAWG::spill(Node* n) const
+{
+    if (nodeFile == NULL && (nodeFile = std::tmpfile()) == NULL) {
+        throw std::runtime_error("failed to create the node file");
+    }
+    int size = n->to.size();
+    if (size > n->spillCapacity) {
+        n->spillOffset = nodeFileSize;
+        n->spillCapacity = size;
+        nodeFileSize += size * RECORD_SIZE;
+    }
+    std::vector<char> buffer(size * RECORD_SIZE);
+    char* record = buffer.data();
+    int k, p;
+    Node* m;
+    for (const auto &[c, value]: n->to) {
+        std::tie(k, p, m) = value;
+        record[0] = c;
+        std::memcpy(record + sizeof(char), &k, sizeof(int));
+        std::memcpy(record + sizeof(char) + sizeof(int), &p, sizeof(int));
+        std::memcpy(record + sizeof(char) + 2 * sizeof(int), &m, sizeof(void*));
+        record += RECORD_SIZE;
+    }
+    if (!buffer.empty() && (std::fseek(nodeFile, n->spillOffset, SEEK_SET) != 0 ||
+        std::fwrite(buffer.data(), 1, buffer.size(), nodeFile) != buffer.size())) {
+        throw std::runtime_error("failed to write the node file");
+    }
+    n->spillSize = size;
+    n->to.clear();
+    n->spilled = true;
+    residentEdges -= size;
+}
+
+/**
+* Spills nodes until the edges in memory fit in the memory limit. The nodes are
+* chosen with the clock algorithm, i.e. a node is spilled if it wasn't used
+* since the clock hand last passed it.
+*
+* No references to the nodes' edges may be held when this is called.
+*/
+void CDAWG::enforceMemoryLimit() const
+{
+    if (memoryLimit == 0) {
+        return;
+    }
+    while (residentEdges * EDGE_BYTES > memoryLimit && !resident.empty()) {
+        if (clockHand >= resident.size()) {
+            clockHand = 0;
+        }
+        Node* n = resident[clockHand];
+        if (n->used) {
+            n->used = false;
+            clockHand++;
+        } else {
+            spill(n);
+            resident[clockHand] = resident.back();
+            resident.pop_back();
+        }
+    }
 }
 
 void CDAWG::buildIndex()
 {
-    // active point
-    NodeAndPos sk = std::make_pair(source, 0);
+    // resume from the active point
+    NodeAndPos sk = activePoint;
     // build the index while decoding the CFG
-    char c;
-    int i = 0;
-    Node* s;
-    int k;
-    for (auto it = cfg->cbegin(), end = cfg->cend(); it != end; ++it) { 
-        c = *it; 
-        // create a new edge (_|_, (-j, -j), source).
-        if (!this->bt->to.contains(c)) {
-            this->bt->edge(c, i, i, this->source);
-        }
-        std::tie(s, k) = sk;
-        sk = this->update(s, k, i, c);
-        i++;
+    int i = textLength;
+    if (construction == GRAMMAR) {
+        buildFromGrammar(sk, i);
+    } else if (construction == PIPELINED) {
+        // decode on another thread and read recent characters from its blocks
+        BlockDecoder decoder(cfg, i);
+        window = &decoder;
+        const char* block;
+        int length;
+        while ((block = decoder.next(length)) != NULL) {
+            for (int j = 0; j < length; j++, i++) {
+                sk = this->extend(sk, i, block[j]);
+                enforceMemoryLimit();
+            }
+        }
+        window = NULL;
+    } else {
+        for (auto it = cfg->cbegin(i), end = cfg->cend(); it != end; ++it, i++) {
+            sk = this->extend(sk, i, *it);
+            enforceMemoryLimit();
+        }
     }
     // manually add end character $
     //c = '$';
@@ -69,12 +211,114 @@ void CDAWG::buildIndex()
     //}
     //std::tie(s, k) = sk;
     //sk = this->update(s, k, i, c);
+
+    activePoint = sk;
+    textLength = i;
+    counted = false;
+    uniques.clear();
+}
+
+/**
+* Indexes the text from position i by traversing the grammar. The first
+* occurrence of each non-terminal character is expanded and its later
+* occurrences are indexed at once when they don't change the CDAWG's
+* structure, so on repetitive texts the construction only reads the
+* characters that add nodes or edges.
+*/
+void CDAWG::buildFromGrammar(NodeAndPos& sk, int& i)
+{
+    expanded.resize(cfg->getStartRule(), false);
+    std::vector<const int*> rules{cfg->getRule(cfg->getStartRule()) + cfg->getStartIndex(i)};
+    while (!rules.empty()) {
+        int c = *rules.back();
+        if (c == CFG::RULE_END) {
+            rules.pop_back();
+            continue;
+        }
+        rules.back()++;
+        if (CFG::isTerminal(c)) {
+            sk = this->extend(sk, i, (char) c);
+            i++;
+        } else if (expanded[c] && fastForward(sk, i, cfg->getExpansionLength(c))) {
+            i += cfg->getExpansionLength(c);
+        } else {
+            expanded[c] = true;
+            rules.push_back(cfg->getRule(c));
+        }
+        enforceMemoryLimit();
+    }
+}
+
+/**
+* Indexes the m characters from position p at once if adding them one at a
+* time wouldn't change the CDAWG's structure, i.e. if the active point followed
+* by them is a path that only enters nodes by solid edges. The active point is
+* moved to the end of the path. The path's labels are compared with the
+* characters by their fingerprints, so only the first character of each edge
+* is decoded.
+*
+* @return Whether the characters were indexed. If not, nothing was changed.
+*/
+bool CDAWG::fastForward(NodeAndPos& sk, int p, int m)
+{
+    Node* s;
+    int k;
+    std::tie(s, k) = sk;
+    int length = s->len + p - k;  // the length of the active point's suffix
+    int depth = p - k;  // how far the active point is on the edge from s
+    int j = 0;
+    while (j < m) {
+        Edges& to = edges(s);
+        auto itr = to.find(charAt((depth > 0) ? k : p + j));
+        if (itr == to.end()) {
+            return false;
+        }
+        int k1, p1;
+        Node* s1;
+        std::tie(k1, p1, s1) = itr->second;
+        // edges to the sink grow with the text, so their labels never end
+        int l = (p1 == OPEN_END) ? m - j : std::min(p1 - k1 + 1 - depth, m - j);
+        if (cfg->getFingerprint(k1 + depth, l) != cfg->getFingerprint(p + j, l)) {
+            return false;
+        }
+        j += l;
+        length += l;
+        if (p1 != OPEN_END && depth + l == p1 - k1 + 1) {
+            // a node entered by a non-solid edge would have to be separated
+            if (s1->len != length) {
+                return false;
+            }
+            s = s1;
+            depth = 0;
+        } else {
+            depth += l;
+        }
+    }
+    sk = std::make_pair(s, p + m - depth);
+    return true;
+}
+
+CDAWG::NodeAndPos CDAWG::extend(NodeAndPos sk, int i, char c)
+{
+    // create a new edge (_|_, (-j, -j), source).
+    if (!edges(this->bt).contains(c)) {
+        setEdge(this->bt, c, i, i, this->source);
+    }
+    Node* s;
+    int k;
+    std::tie(s, k) = sk;
+    return this->update(s, k, i, c);
+}
+
+void CDAWG::append(const CFG* extra)
+{
+    cfg->append(extra);
+    buildIndex();
 }
 
 CDAWG::NodeAndPos CDAWG::update(Node* s, int k, int p, char c)
 {
     // (s, (k, p - 1)) is the canonical reference pair for the active point.
-    int textLength = cfg->getTextLength();
     Node* oldr = NULL;
     Node* s1 = NULL;
     Node* r = NULL;
@@ -94,7 +338,7 @@ CDAWG::NodeAndPos CDAWG::update(Node* s, int k, int p, char c)
         } else {
             r = s;
         }
-        r->edge(cfg->get(p), p, textLength, sink);
+        setEdge(r, charAt(p), p, OPEN_END, sink);
         if (oldr != NULL) {
             oldr->suf = r;
         }
@@ -113,10 +357,10 @@ bool CDAWG::check_end_point(Node* s, int k, int p, char c)
     if (k <= p) {
         int k1, p1;
         Node* s1;
-        std::tie(k1, p1, s1) = s->to[cfg->get(k)];
-        return c == cfg->get(k1 + p - k + 1);
+        std::tie(k1, p1, s1) = edges(s)[charAt(k)];
+        return c == charAt(k1 + p - k + 1);
     }
-    return s->to.contains(c);
+    return edges(s).contains(c);
 }
 
 CDAWG::Node* CDAWG::extension(Node* s, int k, int p)
@@ -125,15 +369,15 @@ CDAWG::Node* CDAWG::extension(Node* s, int k, int p)
     if (k > p) {
         return s;
     }
-    return std::get<2>(s->to[cfg->get(k)]);
+    return std::get<2>(edges(s)[charAt(k)]);
 }
 
 void CDAWG::redirect_edge(Node* s, int k, int p, Node* r)
 {
     int k1, p1;
     Node* s1;
-    std::tie(k1, p1, s1) = s->to[cfg->get(k)];
-    s->edge(cfg->get(k1), k1, k1 + p - k, r);
+    std::tie(k1, p1, s1) = edges(s)[charAt(k)];
+    setEdge(s, charAt(k1), k1, k1 + p - k, r);
 }
 
 CDAWG::Node* CDAWG::split_edge(Node* s, int k, int p)
@@ -141,13 +385,12 @@ CDAWG::Node* CDAWG::split_edge(Node* s, int k, int p)
     // Let (s, (k1, p1), s1) be the w[k]-edge from s.
     int k1, p1;
     Node* s1;
-    std::tie(k1, p1, s1) = s->to[cfg->get(k)];
-    std::string id = "s" + std::to_string(this->sid_count++);
-    Node* r = new Node(id);
+    std::tie(k1, p1, s1) = edges(s)[charAt(k)];
+    Node* r = newNode();
     // Replace the edge by edges (s, (k1, k1 + p - k), r) and
     // (r, (k1 + p - k + 1, p1), s1).
-    s->edge(cfg->get(k1), k1, k1 + p - k, r);
-    r->edge(cfg->get(k1 + p - k + 1), k1 + p - k + 1, p1, s1);
+    setEdge(s, charAt(k1), k1, k1 + p - k, r);
+    setEdge(r, charAt(k1 + p - k + 1), k1 + p - k + 1, p1, s1);
     r->len = s->len + p - k + 1;
     return r;
 }
@@ -171,15 +414,14 @@ CDAWG::NodeAndPos CDAWG::separate_node(Node* s, int k, int p)
 
     // non-solid case: create node r1 as a duplication of s1, together with the
     // out-going edges of s1
-    std::string id = "s" + std::to_string(this->sid_count++);
-    Node* r1 = new Node(id, *s1);
+    Node* r1 = newNode(s1);
     r1->suf = s1->suf;
     s1->suf = r1;
     r1->len = s->len + p - k + 1;
     NodeAndPos r = std::make_pair(s1, k1);
     do {
         // replace the w[k]-edge from s to s1 by edge (s, (k, p), r1)
-        s->edge(cfg->get(k), k, p, r1);
+        setEdge(s, charAt(k), k, p, r1);
         std::tie(s, k) = canonize(s->suf, k, p - 1);
     } while (r == canonize(s, k, p));
     return std::make_pair(r1, p + 1);
@@ -192,12 +434,12 @@ CDAWG::NodeAndPos CDAWG::canonize(Node* s, int k, int p)
     }
     int k1, p1;
     Node* s1;
-    std::tie(k1, p1, s1) = s->to[cfg->get(k)];
+    std::tie(k1, p1, s1) = edges(s)[charAt(k)];
     while (p1 - k1 <= p - k) {
         k = k + p1 - k1 + 1;
         s = s1;
         if (k <= p) {
-            std::tie(k1, p1, s1) = s->to[cfg->get(k)];
+            std::tie(k1, p1, s1) = edges(s)[charAt(k)];
         }
     }
     return std::make_pair(s, k);
@@ -205,6 +447,7 @@ CDAWG::NodeAndPos CDAWG::canonize(Node* s, int k, int p)
 
 bool CDAWG::search(const std::string& pattern)
 {
+    enforceMemoryLimit();
     std::string::size_type i = 0;
     char c;
     Node* m;
@@ -212,44 +455,703 @@ bool CDAWG::search(const std::string& pattern)
     int k, p;
     while (i < pattern.size() && n != sink) {
         c = pattern[i];
-        if (!n->to.contains(c)) {
+        Edges& to = edges(n);
+        auto itr = to.find(c);
+        if (itr == to.end()) {
             return false;
         }
-        std::tie(k, p, m) = n->to[c];
-        for (auto it = cfg->cbegin(k), end = cfg->cend();
-             it != end && k <= p && i < pattern.size();
-             ++it, ++k, c = pattern[++i]) {
-            if (c != *it) {
+        std::tie(k, p, m) = itr->second;
+        // the label's first character is the edge's key so it isn't decoded
+        k++;
+        i++;
+        if (!matchLabel(k, p, pattern, i)) {
+            return false;
+        }
+        n = m;
+    }
+    return i == pattern.size();
+}
+
+std::vector<bool> CDAWG::search(const std::vector<std::string>& patterns, int groupSize)
+{
+    enforceMemoryLimit();
+    std::vector<bool> results(patterns.size());
+    std::vector<BatchQuery> group;
+    size_t next = 0;
+    for (; next < patterns.size() && (int) group.size() < std::max(groupSize, 1); next++) {
+        group.push_back({next, source, 0, false, 0, 0, NULL});
+    }
+    // advance the queries in round-robin order, replacing finished queries
+    // with the next patterns
+    bool found;
+    for (size_t j = 0; !group.empty(); j = (j + 1 < group.size()) ? j + 1 : 0) {
+        BatchQuery& query = group[j];
+        while (advance(query, patterns[query.q], found)) {
+            results[query.q] = found;
+            if (next < patterns.size()) {
+                query = {next++, source, 0, false, 0, 0, NULL};
+            } else {
+                query = group.back();
+                group.pop_back();
+                if (j == group.size()) {
+                    break;
+                }
+            }
+        }
+    }
+    return results;
+}
+
+/**
+* Takes one step of a batch query, i.e. chooses the out-edge of its node or
+* matches its edge's label. Returns whether the query is finished.
+*/
+bool CDAWG::advance(BatchQuery& query, const std::string& pattern, bool& found)
+{
+    auto& [q, n, i, onEdge, k, p, m] = query;
+    if (!onEdge) {
+        if (i == pattern.size() || n == sink) {
+            found = i == pattern.size();
+            return true;
+        }
+        Edges& to = edges(n);
+        auto itr = to.find(pattern[i]);
+        if (itr == to.end()) {
+            found = false;
+            return true;
+        }
+        std::tie(k, p, m) = itr->second;
+        __builtin_prefetch(m);
+        onEdge = true;
+        return false;
+    }
+    // the label's first character is the edge's key so it isn't decoded
+    k++;
+    i++;
+    if (!matchLabel(k, p, pattern, i)) {
+        found = false;
+        return true;
+    }
+    n = m;
+    // the node was prefetched when its edge was chosen, and its edges are the
+    // next dependent miss, so they're fetched while the other queries run
+    __builtin_prefetch(n->to.data());
+    onEdge = false;
+    return false;
+}
+
+/**
+* Matches the label of an edge from text position k up to p with a pattern from
+* position i. The label is decoded one character at a time through the
+* grammar's iterator and the match stops at the first mismatch. If they match,
+* k and i are advanced past the compared characters; the pattern may end before
+* the label.
+*/
+bool CDAWG::matchLabel(int& k, int p, const std::string& pattern, std::string::size_type& i) const
+{
+    // edges to the sink end at the end of the text
+    p = std::min(p, textLength - 1);
+    int length = std::min<long>(p - k + 1, pattern.size() - i);
+    if (length <= 0) {
+        return true;
+    }
+    auto it = cfg->cbegin(k);
+    for (int j = 0; j < length; ++j, ++it) {
+        if (*it != pattern[i + j]) {
+            return false;
+        }
+    }
+    k += length;
+    i += length;
+    return true;
+}
+
+/**
+* Matches a compiled pattern with a depth-first traversal of the CDAWG.
+*
+* At each node only the out-edges whose first character is in the class of the
+* current pattern position are followed. The edge labels are decoded in blocks
+* and each block is tested against the pattern's classes at once.
+*/
+bool CDAWG::search(const Pattern& pattern)
+{
+    enforceMemoryLimit();
+    return searchNode(source, pattern, 0);
+}
+
+bool CDAWG::searchNode(Node* n, const Pattern& pattern, int i)
+{
+    if (i == pattern.size()) {
+        return true;
+    }
+    if (n == sink) {
+        return false;
+    }
+    const std::string& members = pattern.getMembers(i);
+    Edges& to = edges(n);
+    // probe the class members directly if there are fewer of them than edges
+    if (members.size() < to.size()) {
+        for (char c: members) {
+            auto itr = to.find(c);
+            if (itr != to.end() && searchEdge(itr->second, pattern, i)) {
+                return true;
+            }
+        }
+    } else {
+        for (const auto &[c, value]: to) {
+            if (pattern.matches(i, c) && searchEdge(value, pattern, i)) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+/**
+* The edge was chosen by its key, i.e. the label's first character, so the label
+* is matched from its second character. It's decoded a block at a time so a
+* mismatch stops the decoding after at most one block.
+*/
+bool CDAWG::searchEdge(const Edge& e, const Pattern& pattern, int i)
+{
+    int k, p;
+    Node* m;
+    std::tie(k, p, m) = e;
+    // edges to the sink end at the end of the text
+    p = std::min(p, textLength - 1);
+    int length = std::min(p - k + 1, pattern.size() - i);
+    if (length > 1) {
+        char block[SEARCH_BLOCK_SIZE];
+        auto it = cfg->cbegin(k + 1);
+        for (int j = 1, b; j < length; j += b) {
+            b = std::min(length - j, SEARCH_BLOCK_SIZE);
+            for (int l = 0; l < b; ++l, ++it) {
+                block[l] = *it;
+            }
+            if (!pattern.matches(i + j, block, b)) {
                 return false;
             }
         }
+    }
+    return searchNode(m, pattern, i + length);
+}
+
+// counting
+
+/**
+* Counts the occurrences of each node's strings.
+*
+* Each occurrence of a node's string is either followed by one of the node's
+* out-edges or is a suffix of the text, so the counts are computed bottom-up
+* from the sink. Since the text has no unique terminator, the suffixes that
+* occur more than once are found by following suffix links from the active
+* point; they end either at a node or inside an edge.
+*/
+void CDAWG::countOccurrences()
+{
+    int p = textLength - 1;
+    suffixNodes.clear();
+    suffixEdges.clear();
+    Node* s;
+    int k;
+    std::tie(s, k) = activePoint;
+    while (true) {
+        // explicit case
+        if (k > p) {
+            suffixNodes.insert(s);
+            if (s == source) {
+                break;
+            }
+        // implicit case
+        } else {
+            suffixEdges.insert({{s, cfg->get(k)}, p - k + 1});
+        }
+        std::tie(s, k) = canonize(s->suf, k, p);
+    }
+
+    std::set<Node*> visited;
+    countNodes(source, visited);
+    counted = true;
+}
+
+void CDAWG::countNodes(Node* n, std::set<Node*>& visited)
+{
+    if (visited.contains(n)) {
+        return;
+    }
+    visited.insert(n);
+    // copy the edges since they may be spilled while the children are counted
+    enforceMemoryLimit();
+    Edges& to = edges(n);
+    std::vector<std::pair<char, Edge>> out(to.begin(), to.end());
+    n->count = (n == sink || suffixNodes.contains(n)) ? 1 : 0;
+    for (const auto &[c, value]: out) {
+        Node* m = std::get<2>(value);
+        countNodes(m, visited);
+        n->count += m->count;
+        n->count += suffixEdges.count({n, c});
+    }
+}
+
+/**
+* Counts the occurrences of a node's strings per document.
+*
+* The counts are computed bottom-up over the node's sub-DAG like the total
+* counts, but only when a collection is queried so the nodes don't store a count
+* for every document. The document of an occurrence is determined by where it
+* ends, so a child's counts are shifted by the number of separators in the edge
+* label between them. The counts of the nodes below are kept in memo.
+*/
+const std::vector<std::pair<int, int>>& CDAWG::countDocuments(Node* n, DocumentCounts& memo)
+{
+    auto found = memo.find(n);
+    if (found != memo.end()) {
+        return found->second;
+    }
+    // copy the edges since they may be spilled while the children are counted
+    enforceMemoryLimit();
+    Edges& to = edges(n);
+    std::vector<std::pair<char, Edge>> out(to.begin(), to.end());
+    int lastDoc = cfg->getNumDocuments() - 1;
+    std::map<int, int> docs;
+    if (n == sink || suffixNodes.contains(n)) {
+        docs[lastDoc]++;
+    }
+    int k, p;
+    Node* m;
+    for (const auto &[c, value]: out) {
+        std::tie(k, p, m) = value;
+        int shift = cfg->countSeparators(k, std::min(p, textLength - 1));
+        for (const auto &[d, count]: countDocuments(m, memo)) {
+            docs[d - shift] += count;
+        }
+        auto range = suffixEdges.equal_range({n, c});
+        for (auto itr = range.first; itr != range.second; ++itr) {
+            docs[lastDoc - cfg->countSeparators(k, k + itr->second - 1)]++;
+        }
+    }
+    return memo[n] = std::vector<std::pair<int, int>>(docs.begin(), docs.end());
+}
+
+/**
+* Finds the locus of a pattern, i.e. the pattern ends j characters into the
+* c-edge of node n, or at node n if j is 0.
+*/
+bool CDAWG::locate(const std::string& pattern, Node*& n, char& c, int& j)
+{
+    std::string::size_type i = 0;
+    int k, p;
+    Node* m;
+    n = source;
+    j = 0;
+    while (i < pattern.size()) {
+        c = pattern[i];
+        if (n == sink || !edges(n).contains(c)) {
+            return false;
+        }
+        std::tie(k, p, m) = edges(n)[c];
+        p = std::min(p, textLength - 1);
+        for (auto it = cfg->cbegin(k); k + j <= p && i < pattern.size(); ++it, ++j, ++i) {
+            if (pattern[i] != *it) {
+                return false;
+            }
+        }
+        if (k + j <= p) {
+            return true;
+        }
         n = m;
+        j = 0;
     }
-    return i == pattern.size();
+    return true;
 }
 
-void CDAWG::printNodes(Node* n, std::set<std::string>& visited)
+int CDAWG::count(const std::string& pattern)
 {
-    if (visited.contains(n->id)) {
+    enforceMemoryLimit();
+    if (!counted) {
+        countOccurrences();
+    }
+    Node* n;
+    char c;
+    int j;
+    if (!locate(pattern, n, c, j)) {
+        return 0;
+    }
+    if (j == 0) {
+        return n->count;
+    }
+    return countOnEdge(n, c, j);
+}
+
+/**
+* Counts the occurrences of the strings that end j characters into the c-edge
+* of node n, i.e. those of the edge's target and the suffixes of the text that
+* end at least j characters into the edge.
+*/
+int CDAWG::countOnEdge(Node* n, char c, int j)
+{
+    int count = std::get<2>(edges(n)[c])->count;
+    auto range = suffixEdges.equal_range({n, c});
+    for (auto itr = range.first; itr != range.second; ++itr) {
+        if (itr->second >= j) {
+            count++;
+        }
+    }
+    return count;
+}
+
+std::vector<std::pair<int, int>> CDAWG::documents(const std::string& pattern)
+{
+    enforceMemoryLimit();
+    if (!counted) {
+        countOccurrences();
+    }
+    Node* n;
+    char c;
+    int j;
+    if (!locate(pattern, n, c, j)) {
+        return {};
+    }
+    int lastDoc = cfg->getNumDocuments() - 1;
+    if (lastDoc == 0) {
+        int count = this->count(pattern);
+        return {{0, count}};
+    }
+    DocumentCounts memo;
+    if (j == 0) {
+        return countDocuments(n, memo);
+    }
+    // shift the counts of the node below the locus by the separators between them
+    int k, p;
+    Node* m;
+    std::tie(k, p, m) = edges(n)[c];
+    int shift = cfg->countSeparators(k + j, std::min(p, textLength - 1));
+    std::map<int, int> docs;
+    for (const auto &[d, count]: countDocuments(m, memo)) {
+        docs[d - shift] += count;
+    }
+    auto range = suffixEdges.equal_range({n, c});
+    for (auto itr = range.first; itr != range.second; ++itr) {
+        if (itr->second >= j) {
+            docs[lastDoc - cfg->countSeparators(k + j, k + itr->second - 1)]++;
+        }
+    }
+    return std::vector<std::pair<int, int>>(docs.begin(), docs.end());
+}
+
+// maximal repeats
+
+/**
+* The nodes are visited with a depth-first traversal and the top k repeats are
+* kept in a heap whose top is the repeat that would be listed last. An
+* occurrence of a node's string is found from any of its out-edges, since every
+* out-edge label starts at an occurrence that follows the node's string.
+*/
+std::vector<std::tuple<int, int, int>> CDAWG::repeats(int minLength, int k, bool longest)
+{
+    enforceMemoryLimit();
+    if (!counted) {
+        countOccurrences();
+    }
+
+    // order by count or length, breaking ties with the other and the position
+    auto compare = [longest](const auto& a, const auto& b) {
+        const auto &[p1, length1, count1] = a;
+        const auto &[p2, length2, count2] = b;
+        if (longest) {
+            return std::tie(length2, count2, p1) < std::tie(length1, count1, p2);
+        }
+        return std::tie(count2, length2, p1) < std::tie(count1, length1, p2);
+    };
+
+    std::vector<std::tuple<int, int, int>> repeats;
+    std::set<Node*> visited = {source, sink};
+    std::vector<Node*> stack = {source};
+    while (!stack.empty()) {
+        Node* n = stack.back();
+        stack.pop_back();
+        enforceMemoryLimit();
+        Edges& to = edges(n);
+        if (n != source && n->len >= minLength && n->count > 1) {
+            repeats.push_back({std::get<0>(to.begin()->second) - n->len, n->len, n->count});
+            if (k > 0) {
+                std::push_heap(repeats.begin(), repeats.end(), compare);
+                if ((int) repeats.size() > k) {
+                    std::pop_heap(repeats.begin(), repeats.end(), compare);
+                    repeats.pop_back();
+                }
+            }
+        }
+        for (const auto &[c, value]: to) {
+            Node* m = std::get<2>(value);
+            if (!visited.contains(m)) {
+                visited.insert(m);
+                stack.push_back(m);
+            }
+        }
+    }
+    std::sort(repeats.begin(), repeats.end(), compare);
+    return repeats;
+}
+
+// unique substrings
+
+/**
+* A unique substring's occurrence ends inside an edge to the sink, and the
+* strings that end j characters into the c-edge of node n are those of n
+* followed by the first j characters of the edge's label. If no suffix of the
+* text ends deeper than d characters into the edge, the strings that end d + 1
+* characters into it are unique, and the shortest of them, i.e. the string of
+* n's suffix link target preceded by one character and followed by d + 1
+* characters of the label, is a minimal unique substring if dropping its first
+* character makes it repeat. So there's at most one per edge to the sink.
+*/
+const std::vector<std::pair<int, int>>& CDAWG::minimalUniques()
+{
+    if (!counted) {
+        countOccurrences();
+    }
+    if (!uniques.empty()) {
+        return uniques;
+    }
+    std::set<Node*> visited = {source, sink};
+    std::vector<Node*> stack = {source};
+    while (!stack.empty()) {
+        Node* n = stack.back();
+        stack.pop_back();
+        enforceMemoryLimit();
+        for (const auto &[c, value]: edges(n)) {
+            int k, p;
+            Node* m;
+            std::tie(k, p, m) = value;
+            if (m != sink) {
+                if (!visited.contains(m)) {
+                    visited.insert(m);
+                    stack.push_back(m);
+                }
+                continue;
+            }
+            int d = 0;
+            auto range = suffixEdges.equal_range({n, c});
+            for (auto itr = range.first; itr != range.second; ++itr) {
+                d = std::max(d, itr->second);
+            }
+            Node* s;
+            int k1;
+            std::tie(s, k1) = canonize(n->suf, k, k + d);
+            int count = (k1 > k + d) ? s->count : countOnEdge(s, charAt(k1), k + d - k1 + 1);
+            if (count > 1) {
+                int length = n->suf->len + d + 2;
+                uniques.push_back({k + d - length + 1, length});
+            }
+        }
+    }
+    // minimal unique substrings don't contain each other, so they're also
+    // sorted by where they end
+    std::sort(uniques.begin(), uniques.end());
+    return uniques;
+}
+
+std::pair<int, int> CDAWG::shortestUnique(int pos)
+{
+    return shortestUnique(pos, 1)[0];
+}
+
+/**
+* The shortest unique substring that covers position i and contains a minimal
+* unique substring (s, e) spans from min(s, i) to max(e, i). The candidates are
+* the shortest minimal unique substring that contains i, the last one that ends
+* before i, and the first one that starts after i. The ones that contain i are a
+* window of the sorted minimal unique substrings that moves right with i, so
+* their shortest is kept in a deque of increasing lengths.
+*/
+std::vector<std::pair<int, int>> CDAWG::shortestUnique(int pos, int length)
+{
+    if (pos < 0 || length < 0 || pos > textLength - length) {
+        throw std::runtime_error("position out of bounds");
+    }
+    enforceMemoryLimit();
+    const std::vector<std::pair<int, int>>& minimal = minimalUniques();
+    auto end = [&minimal](size_t u) { return minimal[u].first + minimal[u].second - 1; };
+
+    std::vector<std::pair<int, int>> shortest;
+    size_t lo = std::partition_point(minimal.begin(), minimal.end(), [pos](const auto& u) {
+        return u.first + u.second - 1 < pos;
+    }) - minimal.begin();
+    size_t hi = lo;
+    std::deque<size_t> window;
+    for (int i = pos; i < pos + length; i++) {
+        while (hi < minimal.size() && minimal[hi].first <= i) {
+            while (!window.empty() && minimal[window.back()].second > minimal[hi].second) {
+                window.pop_back();
+            }
+            window.push_back(hi++);
+        }
+        while (lo < hi && end(lo) < i) {
+            lo++;
+        }
+        while (!window.empty() && window.front() < lo) {
+            window.pop_front();
+        }
+        // compare the candidates by length and then position
+        std::pair<int, int> best = {textLength + 1, 0};
+        if (lo > 0) {
+            best = std::min(best, {i - minimal[lo - 1].first + 1, minimal[lo - 1].first});
+        }
+        if (!window.empty()) {
+            best = std::min(best, {minimal[window.front()].second, minimal[window.front()].first});
+        }
+        if (hi < minimal.size()) {
+            best = std::min(best, {end(hi) - i + 1, i});
+        }
+        shortest.push_back({best.second, best.first});
+    }
+    return shortest;
+}
+
+// absent words
+
+/**
+* The DAWG states whose strings are in the CDAWG are its nodes, whose suffix
+* links are the DAWG's, and the positions inside its edges. The strings j
+* characters into the c-edge of node n are those of n followed by j characters
+* of the label, so the shortest is a·x where x is the string of n's suffix link
+* target followed by those characters. Reading the label from the target hits
+* the nodes whose strings are such an x, and a·x is only followed by the label's
+* next character, so a·x·b is absent for the target's other right extensions.
+* The sink's strings only occur as suffixes of the text, so the shortest one,
+* i.e. the longest repeated suffix preceded by one character, is followed by
+* nothing.
+*/
+std::vector<std::string> CDAWG::absentWords(int maxLength)
+{
+    enforceMemoryLimit();
+    std::vector<std::string> words;
+    if (textLength == 0) {
+        return words;
+    }
+    // adds a·x·b where x is the length characters at text position pos
+    auto add = [&](char a, int pos, int length, char b) {
+        std::string word(1, a);
+        auto it = cfg->cbegin(pos);
+        for (int j = 0; j < length; ++j, ++it) {
+            word += *it;
+        }
+        word += b;
+        words.push_back(word);
+    };
+
+    std::set<Node*> visited = {source, sink};
+    std::vector<Node*> stack = {source};
+    while (!stack.empty()) {
+        Node* n = stack.back();
+        stack.pop_back();
+        enforceMemoryLimit();
+        Edges& to = edges(n);
+        Node* x = n->suf;
+
+        // the node's own state, whose right extensions are its edges
+        if (n != source && x->len + 2 <= maxLength) {
+            int k = std::get<0>(to.begin()->second);
+            char a = charAt(k - x->len - 1);
+            for (const auto &[b, value]: edges(x)) {
+                if (!to.contains(b)) {
+                    add(a, k - x->len, x->len, b);
+                }
+            }
+        }
+
+        // the states inside the node's edges
+        for (const auto &[c, value]: to) {
+            int k, p;
+            Node* m;
+            std::tie(k, p, m) = value;
+            if (!visited.contains(m)) {
+                visited.insert(m);
+                stack.push_back(m);
+            }
+            if (x->len + 3 > maxLength) {
+                continue;
+            }
+            p = std::min(p, textLength - 1);
+            char a = charAt(k - x->len - 1);
+            Node* s = x;
+            int q = k;  // the text position of the next label character
+            while (q < p) {
+                int k1, p1;
+                Node* s1;
+                std::tie(k1, p1, s1) = edges(s)[charAt(q)];
+                q += std::min(p1, textLength - 1) - k1 + 1;
+                if (q > p || s1->len + 2 > maxLength) {
+                    break;
+                }
+                s = s1;
+                char next = charAt(q);
+                for (const auto &[b, value1]: edges(s)) {
+                    if (b != next) {
+                        add(a, q - s->len, s->len, b);
+                    }
+                }
+            }
+        }
+    }
+
+    // the sink's state, whose suffix link target is the active point
+    Node* s;
+    int k;
+    std::tie(s, k) = activePoint;
+    int length = s->len + textLength - k;
+    if (length + 2 <= maxLength) {
+        char a = charAt(textLength - length - 1);
+        if (k >= textLength) {
+            for (const auto &[b, value]: edges(s)) {
+                add(a, textLength - length, length, b);
+            }
+        } else {
+            int k1 = std::get<0>(edges(s)[charAt(k)]);
+            add(a, textLength - length, length, charAt(k1 + textLength - k));
+        }
+    }
+    return words;
+}
+
+std::string CDAWG::nodeName(const Node* n) const
+{
+    if (n == bt) {
+        return "root";
+    } else if (n == source) {
+        return "source";
+    } else if (n == sink) {
+        return "sink";
+    }
+    return "s" + std::to_string(n->id);
+}
+
+void CDAWG::printNodes(Node* n, std::set<Node*>& visited)
+{
+    if (visited.contains(n)) {
         return;
     }
-    visited.insert(n->id);
-    std::cerr << "id: " << n->id << std::endl;
+    visited.insert(n);
+    std::cerr << "id: " << nodeName(n) << std::endl;
     std::cerr << "\tlen: " << n->len << std::endl;
     if (n->suf == NULL) {
         std::cerr << "\tsuf: None" << std::endl;
     } else {
-        std::cerr << "\tsuf: " << n->suf->id << std::endl;
+        std::cerr << "\tsuf: " << nodeName(n->suf) << std::endl;
     }
     std::cerr << "\tto:" << std::endl;
+    enforceMemoryLimit();
+    Edges& to = edges(n);
+    std::vector<std::pair<char, Edge>> out(to.begin(), to.end());
     int k, p;
     Node* s;
-    for (const auto &[c, value]: n->to) {
+    for (const auto &[c, value]: out) {
         std::tie(k, p, s) = value;
-        std::cerr << "\t\t" << c << ": ((k: " << k << ", p: " << p << "), target: " << s->id << ")" << std::endl;
+        std::cerr << "\t\t" << c << ": ((k: " << k << ", p: " << p << "), target: " << nodeName(s) << ")" << std::endl;
     }
     std::cerr << std::endl;
-    for (const auto &[key, value]: n->to) {
+    for (const auto &[key, value]: out) {
         printNodes(std::get<2>(value), visited);
     }
 }
@@ -257,22 +1159,49 @@ void CDAWG::printNodes(Node* n, std::set<std::string>& visited)
 void CDAWG::printGraph()
 {
     Node* root = bt;
-    std::set<std::string> visited;
+    std::set<Node*> visited;
     printNodes(root, visited);
 }
 
+/**
+* The estimate counts each node and the allocated capacity of its edge array.
+*/
+size_t CDAWG::sizeNodes(Node* n, std::set<Node*>& visited)
+{
+    if (visited.contains(n)) {
+        return 0;
+    }
+    visited.insert(n);
+    enforceMemoryLimit();
+    Edges& to = edges(n);
+    std::vector<std::pair<char, Edge>> out(to.begin(), to.end());
+    size_t size = sizeof(Node) + to.capacity() * sizeof(Edges::value_type);
+    for (const auto &[key, value]: out) {
+        size += sizeNodes(std::get<2>(value), visited);
+    }
+    return size;
+}
+
+size_t CDAWG::sizeInBytes()
+{
+    std::set<Node*> visited;
+    return sizeNodes(source, visited);
+}
+
 // Node
 
-CDAWG::Node::Node(std::string id) : id(id)
+CDAWG::Node::Node(int id) : id(id)
 {
     len = 0;
     suf = NULL;
+    count = 0;
 }
 
-CDAWG::Node::Node(std::string id, Node& n) : id(id), to(n.to)
+CDAWG::Node::Node(int id, Node& n) : to(n.to), id(id)
 {
     len = n.len;
     suf = n.suf;
+    count = 0;
 }
 
 void CDAWG::Node::edge(char c, int k, int p, Node* n)
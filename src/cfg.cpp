@@ -1,21 +1,29 @@
 #include <algorithm>
 #include <cstdio>  // FILE
 #include <fstream>
+#include <random>
+#include <stdexcept>
 #include <sys/stat.h>
+#include <unordered_map>
 #include "cdawg-index/cfg.hpp"
 
 namespace cdawg_index {
 
 // construction
 
-CFG::CFG() { }
+CFG::CFG() : separator(0) { }
 
 // destruction
 
 CFG::~CFG()
 {
-    for (int i = 0; i < rulesSize; i++) {
-        delete[] rules[i];
+    delete[] ruleSizes;
+    // only non-terminal characters have rules; a grammar that failed to load
+    // may have none
+    if (rules != NULL) {
+        for (int i = MR_REPAIR_CHAR_SIZE; i <= startRule; i++) {
+            delete[] rules[i];
+        }
     }
     delete[] rules;
 }
@@ -42,20 +50,23 @@ CFG* CFG::fromMrRepairFile(std::string filename)
     cfg->startRule = cfg->numRules + CFG::MR_REPAIR_CHAR_SIZE;
     int rulesSize = cfg->startRule + 1;  // +1 for start rule
     cfg->rules = new int*[rulesSize];
-    int* ruleSizes = new int[rulesSize - 1];
-    for (int i = 0; i < CFG::MR_REPAIR_CHAR_SIZE; i++) {
-        ruleSizes[i] = 1;
+    // the expansion length of every (non-)terminal character is kept for access
+    cfg->ruleSizes = new int[rulesSize - 1];
+    int* ruleSizes = cfg->ruleSizes;
+    for (int i = 0; i < rulesSize - 1; i++) {
+        ruleSizes[i] = (i < CFG::MR_REPAIR_CHAR_SIZE) ? 1 : 0;
     }
     cfg->rules[cfg->startRule] = new int[cfg->startSize + 1];  // +1 for the dummy code
     int i, j, c, ruleLength;
+    std::vector<int> buffer;
 
     // read rules in order they were added to grammar, i.e. line-by-line
     for (i = CFG::MR_REPAIR_CHAR_SIZE; i < cfg->startRule; i++) {
+        buffer.clear();
         for (j = 0; ;j++) {
             std::getline(reader, line);
             c = std::stoi(line);
-            // use start rule as a buffer
-            cfg->rules[cfg->startRule][j] = c;
+            buffer.push_back(c);
             if (c == CFG::MR_REPAIR_DUMMY_CODE) {
                 break;
             }
@@ -65,7 +76,7 @@ CFG* CFG::fromMrRepairFile(std::string filename)
         cfg->rulesSize += ruleLength;
         cfg->rules[i] = new int[ruleLength + 1];
         for (j = 0; j < ruleLength + 1; j++) {
-            cfg->rules[i][j] = cfg->rules[cfg->startRule][j];
+            cfg->rules[i][j] = buffer[j];
         }
     }
 
@@ -81,9 +92,8 @@ CFG* CFG::fromMrRepairFile(std::string filename)
         pos += ruleSizes[c];
     }
     cfg->rules[cfg->startRule][i] = CFG::MR_REPAIR_DUMMY_CODE;
-
-    // clean up
-    delete[] ruleSizes;
+    cfg->sampleRules();
+    cfg->findAlphabet();
 
     return cfg;
 }
@@ -118,9 +128,11 @@ CFG* CFG::fromNavarroFiles(std::string filenameC, std::string filenameR)
     // prepare to read grammar
     int rulesSize = cfg->startRule + 1;  // +1 for start rule
     cfg->rules = new int*[rulesSize];
-    int* ruleSizes = new int[rulesSize - 1];
-    for (int i = 0; i < CFG::MR_REPAIR_CHAR_SIZE; i++) {
-        ruleSizes[i] = 1;
+    // the expansion length of every (non-)terminal character is kept for access
+    cfg->ruleSizes = new int[rulesSize - 1];
+    int* ruleSizes = cfg->ruleSizes;
+    for (int i = 0; i < rulesSize - 1; i++) {
+        ruleSizes[i] = (i < CFG::MR_REPAIR_CHAR_SIZE) ? 1 : 0;
     }
 
     // read the rule pairs
@@ -174,23 +186,578 @@ CFG* CFG::fromNavarroFiles(std::string filenameC, std::string filenameR)
     }
     cfg->textLength = pos;
     cfg->rules[cfg->startRule][i] = CFG::MR_REPAIR_DUMMY_CODE;
+    cfg->sampleRules();
+    cfg->findAlphabet();
 
-    // clean up
-    delete[] ruleSizes;
+    return cfg;
+}
+
+// construction from a collection of grammars
+
+CFG* CFG::fromCollection(const std::vector<CFG*>& cfgs)
+{
+    // find a character that isn't used by any of the grammars
+    bool used[MR_REPAIR_CHAR_SIZE] = {};
+    int numRules = 0, startSize = 0, rulesSize = 0, textLength = 0;
+    int i, j, c;
+    for (const CFG* doc: cfgs) {
+        for (i = MR_REPAIR_CHAR_SIZE; i <= doc->startRule; i++) {
+            for (j = 0; (c = doc->rules[i][j]) != MR_REPAIR_DUMMY_CODE; j++) {
+                if (c < MR_REPAIR_CHAR_SIZE) {
+                    used[c] = true;
+                }
+            }
+        }
+        numRules += doc->numRules;
+        startSize += doc->startSize;
+        rulesSize += doc->rulesSize;
+        textLength += doc->textLength;
+    }
+    for (c = 0; c < MR_REPAIR_CHAR_SIZE && used[c]; c++);
+    if (c == MR_REPAIR_CHAR_SIZE) {
+        throw std::runtime_error("no character is available for the document separator");
+    }
+    CFG* cfg = new CFG();
+    cfg->separator = (char) c;
+
+    // the start rule also contains a separator between each pair of documents
+    int numSeparators = cfgs.empty() ? 0 : cfgs.size() - 1;
+    cfg->numRules = numRules;
+    cfg->startSize = startSize + numSeparators;
+    cfg->rulesSize = rulesSize;
+    cfg->textLength = textLength + numSeparators;
+    cfg->startRule = numRules + MR_REPAIR_CHAR_SIZE;
+    cfg->rules = new int*[cfg->startRule + 1];
+    cfg->rules[cfg->startRule] = new int[cfg->startSize + 1];  // +1 for the dummy code
+    cfg->ruleSizes = new int[cfg->startRule];
+    for (i = 0; i < MR_REPAIR_CHAR_SIZE; i++) {
+        cfg->ruleSizes[i] = 1;
+    }
+
+    // copy the rules of each grammar with their non-terminals shifted to
+    // follow the non-terminals of the previous grammars
+    int ruleOffset = 0, startOffset = 0, textOffset = 0;
+    int* start = cfg->rules[cfg->startRule];
+    for (size_t d = 0; d < cfgs.size(); d++) {
+        const CFG* doc = cfgs[d];
+        // every document after the first is preceded by a separator, even if
+        // the documents before it are empty
+        if (d > 0) {
+            cfg->separators.push_back(textOffset);
+            cfg->startIndex[textOffset] = startOffset;
+            start[startOffset++] = (unsigned char) cfg->separator;
+            textOffset++;
+        }
+        for (i = MR_REPAIR_CHAR_SIZE; i < doc->startRule; i++) {
+            cfg->rules[i + ruleOffset] = copyRule(doc->rules[i], ruleOffset);
+            cfg->ruleSizes[i + ruleOffset] = doc->ruleSizes[i];
+        }
+        for (i = 0; i < doc->startSize; i++) {
+            c = doc->rules[doc->startRule][i];
+            start[startOffset + i] = (c < MR_REPAIR_CHAR_SIZE) ? c : c + ruleOffset;
+        }
+        for (const auto &[pos, index]: doc->startIndex) {
+            cfg->startIndex[textOffset + pos] = startOffset + index;
+        }
+        ruleOffset += doc->numRules;
+        startOffset += doc->startSize;
+        textOffset += doc->textLength;
+    }
+    start[startOffset] = MR_REPAIR_DUMMY_CODE;
+    cfg->sampleRules();
+    cfg->findAlphabet();
 
     return cfg;
 }
 
+/** Copies a rule, shifting its non-terminal characters by the given offset. */
+int* CFG::copyRule(const int* rule, int ruleOffset)
+{
+    int i, c;
+    for (i = 0; rule[i] != MR_REPAIR_DUMMY_CODE; i++);
+    int* copy = new int[i + 1];  // +1 for the dummy code
+    for (i = 0; (c = rule[i]) != MR_REPAIR_DUMMY_CODE; i++) {
+        copy[i] = (c < MR_REPAIR_CHAR_SIZE) ? c : c + ruleOffset;
+    }
+    copy[i] = MR_REPAIR_DUMMY_CODE;
+    return copy;
+}
+
+// appending
+
+void CFG::append(const CFG* cfg)
+{
+    // make room for the other grammar's rules before the start rule
+    int ruleOffset = numRules;
+    int oldStartRule = startRule;
+    int* start = rules[oldStartRule];
+    numRules += cfg->numRules;
+    startRule = numRules + MR_REPAIR_CHAR_SIZE;
+    int capacity = std::max(rulesCapacity, oldStartRule + 1);
+    if (startRule + 1 > capacity) {
+        rulesCapacity = std::max(startRule + 1, 2 * capacity);
+        int** newRules = new int*[rulesCapacity];
+        int* newRuleSizes = new int[rulesCapacity];
+        std::copy(rules + MR_REPAIR_CHAR_SIZE, rules + oldStartRule, newRules + MR_REPAIR_CHAR_SIZE);
+        std::copy(ruleSizes, ruleSizes + oldStartRule, newRuleSizes);
+        delete[] rules;
+        delete[] ruleSizes;
+        rules = newRules;
+        ruleSizes = newRuleSizes;
+    }
+    for (int i = MR_REPAIR_CHAR_SIZE; i < cfg->startRule; i++) {
+        rules[i + ruleOffset] = copyRule(cfg->rules[i], ruleOffset);
+        ruleSizes[i + ruleOffset] = cfg->ruleSizes[i];
+    }
+
+    // extend the start rule
+    int size = startSize + cfg->startSize + 1;  // +1 for the dummy code
+    capacity = std::max(startCapacity, startSize + 1);
+    if (size > capacity) {
+        startCapacity = std::max(size, 2 * capacity);
+        int* newStart = new int[startCapacity];
+        std::copy(start, start + startSize, newStart);
+        delete[] start;
+        start = newStart;
+    }
+    const int* other = cfg->rules[cfg->startRule];
+    for (int i = 0; i <= cfg->startSize; i++) {
+        int c = other[i];
+        start[startSize + i] = (c < MR_REPAIR_CHAR_SIZE) ? c : c + ruleOffset;
+    }
+    rules[startRule] = start;
+    // the new positions come after the old ones, i.e. first in reversed order
+    for (auto it = cfg->startIndex.rbegin(); it != cfg->startIndex.rend(); it++) {
+        startIndex.emplace_hint(startIndex.begin(), textLength + it->first, startSize + it->second);
+    }
+
+    int oldStartSize = startSize;
+    startSize += cfg->startSize;
+    rulesSize += cfg->rulesSize;
+    textLength += cfg->textLength;
+    sampleRules(oldStartRule);
+    findAlphabet(oldStartRule, oldStartSize);
+    if (fingerprintBase != 0) {
+        fingerprintRules(oldStartRule, oldStartSize);
+    }
+}
+
+// rebalancing
+
+namespace {
+
+/**
+* Builds AVL-balanced binary rules by concatenating (non-)terminal characters.
+*
+* Rules are hash-consed so equal pairs share a non-terminal. Concatenating two
+* characters whose heights differ by h creates O(h) rules.
+*/
+class Balancer
+{
+
+private:
+
+    int charSize;
+    std::unordered_map<uint64_t, int> pairs;
+
+public:
+
+    // indexed by non-terminal minus charSize
+    std::vector<int> left, right, height, size;
+
+    Balancer(int charSize) : charSize(charSize) { }
+
+    int getHeight(int x) const { return (x < charSize) ? 0 : height[x - charSize]; }
+    int getSize(int x) const { return (x < charSize) ? 1 : size[x - charSize]; }
+
+    int make(int a, int b)
+    {
+        uint64_t key = ((uint64_t) (uint32_t) a << 32) | (uint32_t) b;
+        auto itr = pairs.find(key);
+        if (itr != pairs.end()) {
+            return itr->second;
+        }
+        int x = charSize + left.size();
+        left.push_back(a);
+        right.push_back(b);
+        height.push_back(1 + std::max(getHeight(a), getHeight(b)));
+        size.push_back(getSize(a) + getSize(b));
+        pairs[key] = x;
+        return x;
+    }
+
+    int concat(int a, int b)
+    {
+        int ha = getHeight(a), hb = getHeight(b);
+        if (ha - hb <= 1 && hb - ha <= 1) {
+            return make(a, b);
+        }
+        // descend the right spine of a
+        if (ha > hb) {
+            int l = left[a - charSize];
+            int t = concat(right[a - charSize], b);
+            if (getHeight(t) <= getHeight(l) + 1) {
+                return make(l, t);
+            }
+            int t1 = left[t - charSize], t2 = right[t - charSize];
+            if (getHeight(t1) <= getHeight(t2)) {
+                return make(make(l, t1), t2);
+            }
+            int u1 = left[t1 - charSize], u2 = right[t1 - charSize];
+            return make(make(l, u1), make(u2, t2));
+        }
+        // descend the left spine of b
+        int r = right[b - charSize];
+        int t = concat(a, left[b - charSize]);
+        if (getHeight(t) <= getHeight(r) + 1) {
+            return make(t, r);
+        }
+        int t1 = left[t - charSize], t2 = right[t - charSize];
+        if (getHeight(t2) <= getHeight(t1)) {
+            return make(t1, make(t2, r));
+        }
+        int u1 = left[t2 - charSize], u2 = right[t2 - charSize];
+        return make(make(t1, u1), make(u2, r));
+    }
+
+    /** Concatenates a sequence by concatenating adjacent pairs in rounds. */
+    int concat(std::vector<int>& xs)
+    {
+        while (xs.size() > 1) {
+            size_t j = 0;
+            for (size_t i = 0; i < xs.size(); i += 2) {
+                xs[j++] = (i + 1 < xs.size()) ? concat(xs[i], xs[i + 1]) : xs[i];
+            }
+            xs.resize(j);
+        }
+        return xs[0];
+    }
+
+};
+
+}
+
+void CFG::rebalance()
+{
+    // balance the rules in order since they only use earlier rules
+    Balancer balancer(MR_REPAIR_CHAR_SIZE);
+    std::vector<int> balanced(startRule);
+    std::vector<int> xs;
+    int i, j, c;
+    for (c = 0; c < MR_REPAIR_CHAR_SIZE; c++) {
+        balanced[c] = c;
+    }
+    for (i = MR_REPAIR_CHAR_SIZE; i < startRule; i++) {
+        xs.clear();
+        for (j = 0; (c = rules[i][j]) != MR_REPAIR_DUMMY_CODE; j++) {
+            xs.push_back(balanced[c]);
+        }
+        balanced[i] = balancer.concat(xs);
+    }
+
+    // keep only the balanced rules that are used by the start rule
+    int numBalanced = balancer.left.size();
+    std::vector<int> ids(numBalanced, -1);
+    std::vector<int> stack;
+    for (i = 0; i < startSize; i++) {
+        c = balanced[rules[startRule][i]];
+        if (c >= MR_REPAIR_CHAR_SIZE) {
+            stack.push_back(c);
+        }
+    }
+    while (!stack.empty()) {
+        c = stack.back() - MR_REPAIR_CHAR_SIZE;
+        stack.pop_back();
+        if (ids[c] != -1) {
+            continue;
+        }
+        ids[c] = 0;
+        for (int child: {balancer.left[c], balancer.right[c]}) {
+            if (child >= MR_REPAIR_CHAR_SIZE && ids[child - MR_REPAIR_CHAR_SIZE] == -1) {
+                stack.push_back(child);
+            }
+        }
+    }
+    // rules are numbered in the order they were made so children come first
+    int newNumRules = 0;
+    for (i = 0; i < numBalanced; i++) {
+        if (ids[i] != -1) {
+            ids[i] = MR_REPAIR_CHAR_SIZE + newNumRules++;
+        }
+    }
+    auto rename = [&](int x) {
+        return (x < MR_REPAIR_CHAR_SIZE) ? x : ids[x - MR_REPAIR_CHAR_SIZE];
+    };
+
+    // replace the rules
+    int newStartRule = newNumRules + MR_REPAIR_CHAR_SIZE;
+    int** newRules = new int*[newStartRule + 1];
+    int* newRuleSizes = new int[newStartRule];
+    for (c = 0; c < MR_REPAIR_CHAR_SIZE; c++) {
+        newRuleSizes[c] = 1;
+    }
+    for (i = 0; i < numBalanced; i++) {
+        if (ids[i] != -1) {
+            newRules[ids[i]] = new int[3]{
+                rename(balancer.left[i]), rename(balancer.right[i]), MR_REPAIR_DUMMY_CODE
+            };
+            newRuleSizes[ids[i]] = balancer.size[i];
+        }
+    }
+    newRules[newStartRule] = rules[startRule];
+    for (i = 0; i < startSize; i++) {
+        newRules[newStartRule][i] = rename(balanced[newRules[newStartRule][i]]);
+    }
+    for (i = MR_REPAIR_CHAR_SIZE; i < startRule; i++) {
+        delete[] rules[i];
+    }
+    delete[] rules;
+    delete[] ruleSizes;
+    rules = newRules;
+    ruleSizes = newRuleSizes;
+    rulesCapacity = 0;
+    numRules = newNumRules;
+    startRule = newStartRule;
+    rulesSize = 2 * newNumRules;
+    sampleRules();
+    if (fingerprintBase != 0) {
+        fingerprintRules();
+    }
+}
+
+int CFG::getHeight() const
+{
+    // rules only use earlier rules
+    std::vector<int> heights(startRule + 1, 0);
+    int i, j, c;
+    for (i = MR_REPAIR_CHAR_SIZE; i <= startRule; i++) {
+        for (j = 0; (c = rules[i][j]) != MR_REPAIR_DUMMY_CODE; j++) {
+            heights[i] = std::max(heights[i], heights[c] + 1);
+        }
+    }
+    return heights[startRule];
+}
+
+// alphabet
+
+/**
+* Adds the characters of the rules from firstRule on and of the start rule from
+* index firstStart on to the alphabet; the earlier rules' characters are
+* already in it.
+*/
+void CFG::findAlphabet(int firstRule, int firstStart)
+{
+    std::vector<bool> used(MR_REPAIR_CHAR_SIZE, false);
+    for (char c: alphabet) {
+        used[(unsigned char) c] = true;
+    }
+    for (int r = firstRule; r <= startRule; r++) {
+        for (int i = (r == startRule) ? firstStart : 0, c; (c = rules[r][i]) != MR_REPAIR_DUMMY_CODE; i++) {
+            if (c < MR_REPAIR_CHAR_SIZE) {
+                used[c] = true;
+            }
+        }
+    }
+    alphabet.clear();
+    for (int c = 0; c < MR_REPAIR_CHAR_SIZE; c++) {
+        if (used[c]) {
+            alphabet.push_back((char) c);
+        }
+    }
+}
+
+// entry points
+
+/**
+* Samples the entry points of the rules from the given rule on; the earlier
+* rules keep their samples.
+*/
+void CFG::sampleRules(int first)
+{
+    sampleBegin.resize(startRule + 1, 0);
+    samples.resize(sampleBegin[first]);
+    for (int r = first; r < startRule; r++) {
+        sampleBegin[r] = samples.size();
+        int offset = 0;
+        for (int i = 0, c; (c = rules[r][i]) != MR_REPAIR_DUMMY_CODE; i++) {
+            if (i > 0 && i % RULE_SAMPLE_RATE == 0) {
+                samples.push_back(offset);
+            }
+            offset += ruleSizes[c];
+        }
+    }
+    sampleBegin[startRule] = samples.size();
+}
+
+/**
+* Gets the index in rule r to start scanning from to reach the given offset in
+* the rule's expansion, i.e. the last entry point at or before the offset. The
+* offset is made relative to the entry point.
+*/
+int CFG::entryPoint(int r, int& offset) const
+{
+    auto first = samples.begin() + sampleBegin[r];
+    auto last = samples.begin() + sampleBegin[r + 1];
+    int t = std::upper_bound(first, last, offset) - first;
+    if (t == 0) {
+        return 0;
+    }
+    offset -= *(first + t - 1);
+    return t * RULE_SAMPLE_RATE;
+}
+
+// fingerprints
+
+namespace {
+
+const uint64_t FINGERPRINT_PRIME = (1ull << 61) - 1;
+
+uint64_t multiplyMod(uint64_t a, uint64_t b)
+{
+    __uint128_t x = (__uint128_t) a * b;
+    uint64_t y = (uint64_t) (x & FINGERPRINT_PRIME) + (uint64_t) (x >> 61);
+    return (y >= FINGERPRINT_PRIME) ? y - FINGERPRINT_PRIME : y;
+}
+
+/** Gets the fingerprint of the concatenation of strings with fingerprints f and g. */
+uint64_t concatenate(uint64_t f, uint64_t gPower, uint64_t g)
+{
+    uint64_t y = multiplyMod(f, gPower) + g;
+    return (y >= FINGERPRINT_PRIME) ? y - FINGERPRINT_PRIME : y;
+}
+
+}
+
+void CFG::computeFingerprints()
+{
+    std::random_device random;
+    uint64_t base = ((uint64_t) random() << 32) | random();
+    fingerprintBase = 2 + base % (FINGERPRINT_PRIME - 2);
+    fingerprintRules();
+}
+
+/**
+* Fingerprints the rules from firstRule on and the start rule from index
+* firstStart on; the earlier rules keep their fingerprints.
+*/
+void CFG::fingerprintRules(int firstRule, int firstStart)
+{
+    symbolFingerprints.resize(startRule);
+    symbolPowers.resize(startRule);
+    if (firstRule == MR_REPAIR_CHAR_SIZE) {
+        for (int c = 0; c < MR_REPAIR_CHAR_SIZE; c++) {
+            symbolFingerprints[c] = c + 1;
+            symbolPowers[c] = fingerprintBase;
+        }
+    }
+    sampleFingerprints.resize(sampleBegin[firstRule]);
+    for (int r = firstRule; r < startRule; r++) {
+        uint64_t f = 0, p = 1;
+        for (int i = 0, c; (c = rules[r][i]) != MR_REPAIR_DUMMY_CODE; i++) {
+            if (i > 0 && i % RULE_SAMPLE_RATE == 0) {
+                sampleFingerprints.push_back(f);
+            }
+            f = concatenate(f, symbolPowers[c], symbolFingerprints[c]);
+            p = multiplyMod(p, symbolPowers[c]);
+        }
+        symbolFingerprints[r] = f;
+        symbolPowers[r] = p;
+    }
+    startFingerprints.resize(firstStart + 1);
+    for (int i = firstStart; i < startSize; i++) {
+        int c = rules[startRule][i];
+        startFingerprints.push_back(concatenate(startFingerprints[i], symbolPowers[c], symbolFingerprints[c]));
+    }
+}
+
+/** Gets the base to the power of the given length. */
+uint64_t CFG::power(int length) const
+{
+    uint64_t p = 1, b = fingerprintBase;
+    for (; length > 0; length >>= 1) {
+        if (length & 1) {
+            p = multiplyMod(p, b);
+        }
+        b = multiplyMod(b, b);
+    }
+    return p;
+}
+
+/** Gets the fingerprint of the text's first q characters. */
+uint64_t CFG::prefixFingerprint(int q) const
+{
+    if (q >= textLength) {
+        return startFingerprints[startSize];
+    }
+    // NOTE: map keys are reversed so this finds the largest key that's <= q
+    auto itr = startIndex.lower_bound(q);
+    int pos = itr->first;
+    uint64_t f = startFingerprints[itr->second];
+
+    // descend to q, adding the whole (non-)terminals before it
+    int c = rules[startRule][itr->second];
+    while (pos < q) {
+        int offset = q - pos;
+        int index = entryPoint(c, offset);
+        const int* rule = rules[c] + index;
+        if (index > 0) {
+            uint64_t g = sampleFingerprints[sampleBegin[c] + index / RULE_SAMPLE_RATE - 1];
+            f = concatenate(f, power(q - offset - pos), g);
+        }
+        pos = q - offset;
+        for (c = *rule; pos + ruleSizes[c] <= q; c = *(++rule)) {
+            f = concatenate(f, symbolPowers[c], symbolFingerprints[c]);
+            pos += ruleSizes[c];
+        }
+    }
+    return f;
+}
+
+uint64_t CFG::getFingerprint(int q, int length) const
+{
+    uint64_t f = prefixFingerprint(q + length);
+    uint64_t g = multiplyMod(prefixFingerprint(q), power(length));
+    return (f >= g) ? f - g : f + FINGERPRINT_PRIME - g;
+}
+
+// documents
+
+int CFG::getDocument(int q) const
+{
+    return std::upper_bound(separators.begin(), separators.end(), q) - separators.begin();
+}
+
+int CFG::countSeparators(int k, int p) const
+{
+    if (k > p) {
+        return 0;
+    }
+    auto first = std::lower_bound(separators.begin(), separators.end(), k);
+    auto last = std::upper_bound(first, separators.end(), p);
+    return last - first;
+}
+
 // access single character
 
 /**
-* A naive implementation of random access.
+* Random access by descending the grammar.
 *
 * The text positions of the (non-)terminal characters in the start rule are
-* indexed when the grammar is loaded. Then any position is accessed by getting
-* the closest indexed position and decoding the grammar up to the query position,
-* ignoring the decoded characters prior to the query position.
+* indexed when the grammar is loaded. A position is accessed by getting the
+* closest indexed position and descending into the (non-)terminal characters
+* that contain the query position, skipping the others by their expansion
+* lengths. The time is proportional to the height of the grammar (times the
+* length of its rules) rather than the length of the start rule's expansions.
 */
+int CFG::getStartIndex(int q) const
+{
+    if (q >= textLength) {
+        return startSize;
+    }
+    // NOTE: map keys are reversed so this finds the largest key that's <= q
+    return startIndex.lower_bound(q)->second;
+}
+
 char CFG::get(int q) const
 {
 
@@ -200,35 +767,17 @@ char CFG::get(int q) const
         throw std::runtime_error("q out of bounds");
     }
     int pos = itr->first;
-    int length = q - pos + 1;
-
-    // TODO: stacks should be preallocated to size of max depth
-    int r = startRule;
-    int i = itr->second;
-    char c;
-    std::stack<int> ruleStack;
-    std::stack<int> indexStack;
-    for (int j = 0; j < length;) {
-        // end of rule
-        if (rules[r][i] == MR_REPAIR_DUMMY_CODE) {
-            r = ruleStack.top();
-            ruleStack.pop();
-            i = indexStack.top();
-            indexStack.pop();
-        // terminal character
-        } else if (rules[r][i] < MR_REPAIR_CHAR_SIZE) {
-            c = (char) rules[r][i];
-            i++;
-            j++;
-        // non-terminal character
-        } else {
-            ruleStack.push(r);
-            r = rules[r][i];
-            indexStack.push(i + 1);
-            i = 0;
+
+    int c = rules[startRule][itr->second];
+    while (c >= MR_REPAIR_CHAR_SIZE) {
+        int offset = q - pos;
+        int* rule = rules[c] + entryPoint(c, offset);
+        pos = q - offset;
+        for (c = *rule; pos + ruleSizes[c] <= q; c = *(++rule)) {
+            pos += ruleSizes[c];
         }
     }
-    return c;
+    return (char) c;
 }
 
 // iterator
@@ -248,6 +797,23 @@ CFG::ConstIterator::ConstIterator(const CFG* cfg, int pos) : parent(cfg), j(pos)
     skip = pos - itr->first;
     i = itr->second;
 
+    // descend to the terminal character at pos, skipping whole (non-)terminals
+    int c;
+    while (true) {
+        c = parent->rules[r][i];
+        if (skip >= parent->ruleSizes[c]) {
+            skip -= parent->ruleSizes[c];
+            i++;
+        } else if (c < MR_REPAIR_CHAR_SIZE) {
+            break;
+        } else {
+            ruleStack.push(r);
+            r = c;
+            indexStack.push(i + 1);
+            i = parent->entryPoint(r, skip);
+        }
+    }
+
     next();
 }
 
@@ -1,8 +1,17 @@
+#include <algorithm>
 #include <chrono>
+#include <fstream>
 #include <iostream>
+#include <memory>
 #include <random>
+#include <set>
+#include <vector>
+#include "cdawg-index/block_cache.hpp"
 #include "cdawg-index/cdawg.hpp"
 #include "cdawg-index/cfg.hpp"
+#include "cdawg-index/packed_cdawg.hpp"
+#include "cdawg-index/pattern.hpp"
+#include "cdawg-index/perf_counters.hpp"
 
 using namespace std;
 using namespace cdawg_index;
@@ -13,16 +22,30 @@ void usage(int argc, char* argv[]) {
     cerr << "commands: " << endl;
     cerr << "\tindex: creates a CDAWG index for the given grammar" << endl;
     cerr << "\tsearch: uses a CDAWG index to search the given grammar" << endl;
+    cerr << "\tdocuments: lists the documents in a collection of grammars that contain a pattern" << endl;
+    cerr << "\trepeats: lists the most frequent or longest maximal repeats of a grammar's text" << endl;
+    cerr << "\tcontext: prints the text surrounding positions in a grammar's text" << endl;
+    cerr << "\tunique: prints the shortest unique substrings that cover positions in a grammar's text" << endl;
+    cerr << "\tabsent: lists the minimal absent words of a grammar's text" << endl;
+    cerr << "\tbalance: reports the height, size, and access time of a grammar before and after rebalancing it" << endl;
+    cerr << "\tbenchmark: reports the build time, size, and query times of a grammar's indexes" << endl;
 }
 
 void usageIndex(int argc, char* argv[]) {
-    cerr << "usage: " << argv[0] << " index <type> <filename>" << endl;
+    cerr << "usage: " << argv[0] << " index <type> <filename> [--edge-memory-limit <megabytes>] [--construction <construction>] [--rebalance] [--append <filename>]..." << endl;
     cerr << endl;
     cerr << "args: " << endl;
     cerr << "\ttype={mrrepair|navarro}: the type of grammar to load" << endl;
     cerr << "\t\tmrrepair: for grammars created with the MR-RePair algorithm" << endl;
     cerr << "\t\tnavarro: for grammars created with Navarro's implementation of RePair" << endl;
     cerr << "\tfilename: the name of the grammar file(s) without the extension" << endl;
+    cerr << "\tmegabytes: the memory the CDAWG's edges may use before they're spilled to a temporary file" << endl;
+    cerr << "\tconstruction={decoded|pipelined|grammar}: how the text is read while the CDAWG is built" << endl;
+    cerr << "\t\tdecoded: decode the text character by character (default)" << endl;
+    cerr << "\t\tpipelined: decode the text on another thread" << endl;
+    cerr << "\t\tgrammar: traverse the grammar, indexing repeated rule expansions at once" << endl;
+    cerr << "\t--rebalance: rebalances the grammar after it's loaded so its height is logarithmic in the text length" << endl;
+    cerr << "\t--append: a grammar of the same type whose text is appended to the index after it's built" << endl;
     cerr << endl;
     cerr << "output: " << endl;
     cerr << "\t<filename>.cdawg: a file containing the computed CDAWG index" << endl;
@@ -39,6 +62,98 @@ void usageSearch(int argc, char* argv[]) {
     cerr << "\tpattern: the pattern to search for" << endl;
 }
 
+void usageDocuments(int argc, char* argv[]) {
+    cerr << "usage: " << argv[0] << " documents <type> <list> <pattern>" << endl;
+    cerr << endl;
+    cerr << "args: " << endl;
+    cerr << "\ttype={mrrepair|navarro}: the type of grammar-compressed strings to load" << endl;
+    cerr << "\t\tmrrepair: for grammars created with the MR-RePair algorithm" << endl;
+    cerr << "\t\tnavarro: for grammars created with Navarro's implementation of RePair" << endl;
+    cerr << "\tlist: a file with the name of each document's grammar file(s) without the extension on its own line" << endl;
+    cerr << "\tpattern: the pattern to search for" << endl;
+    cerr << endl;
+    cerr << "output: " << endl;
+    cerr << "\tthe name and number of occurrences of each document that contains the pattern" << endl;
+}
+
+void usageRepeats(int argc, char* argv[]) {
+    cerr << "usage: " << argv[0] << " repeats <type> <filename> <min-length> <k> [frequent|longest]" << endl;
+    cerr << endl;
+    cerr << "args: " << endl;
+    cerr << "\ttype={mrrepair|navarro}: the type of grammar to load" << endl;
+    cerr << "\t\tmrrepair: for grammars created with the MR-RePair algorithm" << endl;
+    cerr << "\t\tnavarro: for grammars created with Navarro's implementation of RePair" << endl;
+    cerr << "\tfilename: the name of the grammar file(s) without the extension" << endl;
+    cerr << "\tmin-length: the shortest repeat to list" << endl;
+    cerr << "\tk: the number of repeats to list, or 0 to list all of them" << endl;
+    cerr << "\tfrequent|longest: whether to list the most frequent (default) or the longest repeats" << endl;
+    cerr << endl;
+    cerr << "output: " << endl;
+    cerr << "\tthe number of occurrences, length, and text of each repeat with newlines and tabs replaced by spaces" << endl;
+}
+
+void usageContext(int argc, char* argv[]) {
+    cerr << "usage: " << argv[0] << " context <type> <filename> <before> <after> [<position> ...]" << endl;
+    cerr << endl;
+    cerr << "args: " << endl;
+    cerr << "\ttype={mrrepair|navarro}: the type of grammar to load" << endl;
+    cerr << "\t\tmrrepair: for grammars created with the MR-RePair algorithm" << endl;
+    cerr << "\t\tnavarro: for grammars created with Navarro's implementation of RePair" << endl;
+    cerr << "\tfilename: the name of the grammar file(s) without the extension" << endl;
+    cerr << "\tbefore: the number of characters to print before each position" << endl;
+    cerr << "\tafter: the number of characters to print from each position on" << endl;
+    cerr << "\tposition: a text position; read from standard input, one per line, if none are given" << endl;
+    cerr << endl;
+    cerr << "output: " << endl;
+    cerr << "\teach position and its surrounding text with newlines and tabs replaced by spaces" << endl;
+}
+
+void usageUnique(int argc, char* argv[]) {
+    cerr << "usage: " << argv[0] << " unique <type> <filename> <position> [<length>]" << endl;
+    cerr << endl;
+    cerr << "args: " << endl;
+    cerr << "\ttype={mrrepair|navarro}: the type of grammar to load" << endl;
+    cerr << "\t\tmrrepair: for grammars created with the MR-RePair algorithm" << endl;
+    cerr << "\t\tnavarro: for grammars created with Navarro's implementation of RePair" << endl;
+    cerr << "\tfilename: the name of the grammar file(s) without the extension" << endl;
+    cerr << "\tposition: the text position of the first position to cover" << endl;
+    cerr << "\tlength: the number of positions to cover, 1 by default" << endl;
+    cerr << endl;
+    cerr << "output: " << endl;
+    cerr << "\teach position and the position, length, and text of its shortest unique substring with newlines and tabs replaced by spaces" << endl;
+}
+
+void usageAbsent(int argc, char* argv[]) {
+    cerr << "usage: " << argv[0] << " absent <type> <filename> <max-length>" << endl;
+    cerr << endl;
+    cerr << "args: " << endl;
+    cerr << "\ttype={mrrepair|navarro}: the type of grammar to load" << endl;
+    cerr << "\t\tmrrepair: for grammars created with the MR-RePair algorithm" << endl;
+    cerr << "\t\tnavarro: for grammars created with Navarro's implementation of RePair" << endl;
+    cerr << "\tfilename: the name of the grammar file(s) without the extension" << endl;
+    cerr << "\tmax-length: the longest absent word to list" << endl;
+    cerr << endl;
+    cerr << "output: " << endl;
+    cerr << "\teach minimal absent word, shortest first, with newlines and tabs replaced by spaces" << endl;
+}
+
+void usageBalance(int argc, char* argv[]) {
+    cerr << "usage: " << argv[0] << " balance <type> <filename>" << endl;
+    cerr << endl;
+    cerr << "args: " << endl;
+    cerr << "\ttype={mrrepair|navarro}: the type of grammar to load" << endl;
+    cerr << "\t\tmrrepair: for grammars created with the MR-RePair algorithm" << endl;
+    cerr << "\t\tnavarro: for grammars created with Navarro's implementation of RePair" << endl;
+    cerr << "\tfilename: the name of the grammar file(s) without the extension" << endl;
+}
+
+void usageBenchmark(int argc, char* argv[]) {
+    cerr << "usage: " << argv[0] << " benchmark <type> <filename> [--edge-memory-limit <megabytes>] [--rebalance] [--counters]" << endl;
+    cerr << endl;
+    cerr << "args: same as \"index\" command, except --construction and --append" << endl;
+    cerr << "\t--counters: also reports hardware performance counters of the load, build, and query phases" << endl;
+}
+
 CFG* loadGrammar(string type, string filename) {
     if (type == "mrrepair") {
         return CFG::fromMrRepairFile(filename + ".out");
@@ -50,6 +165,100 @@ CFG* loadGrammar(string type, string filename) {
     return NULL;
 }
 
+// the options that may follow a command's arguments, in any order
+struct Options {
+    size_t edgeMemoryLimit = 0;  // in bytes
+    CDAWG::Construction construction = CDAWG::DECODED;
+    vector<string> appended;  // the grammars to append after the index is built
+    bool rebalance = false;  // whether to rebalance the grammars after they're loaded
+    bool counters = false;  // whether to report hardware performance counters
+};
+
+// parses the options starting from argument i
+bool parseOptions(int argc, char* argv[], int i, Options& options) {
+    for (; i < argc; i++) {
+        string option = argv[i];
+        if (option == "--rebalance") {
+            options.rebalance = true;
+            continue;
+        } else if (option == "--counters") {
+            options.counters = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            return false;
+        }
+        if (option == "--edge-memory-limit") {
+            options.edgeMemoryLimit = stoul(argv[++i]) << 20;
+        } else if (option == "--construction") {
+            string construction = argv[++i];
+            if (construction == "decoded") {
+                options.construction = CDAWG::DECODED;
+            } else if (construction == "pipelined") {
+                options.construction = CDAWG::PIPELINED;
+            } else if (construction == "grammar") {
+                options.construction = CDAWG::GRAMMAR;
+            } else {
+                return false;
+            }
+        } else if (option == "--append") {
+            options.appended.push_back(argv[++i]);
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+// starts and stops the counters if they're reported
+void startCounters(PerfCounters* counters) {
+    if (counters != NULL) {
+        counters->start();
+    }
+}
+
+void stopCounters(PerfCounters* counters) {
+    if (counters != NULL) {
+        counters->stop();
+    }
+}
+
+// reports the counters of a phase divided by the number of units, e.g. queries
+void reportCounters(const string& phase, const PerfCounters& counters, double numUnits, const string& unit) {
+    cerr << phase << " counters:";
+    for (int e = 0; e < PerfCounters::NUM_EVENTS; e++) {
+        PerfCounters::Event event = (PerfCounters::Event) e;
+        cerr << ((e == 0) ? " " : ", ") << PerfCounters::getName(event) << " ";
+        if (counters.available(event)) {
+            cerr << counters.get(event) / numUnits;
+        } else {
+            cerr << "n/a";
+        }
+    }
+    cerr << " per " << unit;
+    if (counters.available(PerfCounters::CYCLES) && counters.available(PerfCounters::INSTRUCTIONS) &&
+        counters.get(PerfCounters::CYCLES) > 0) {
+        cerr << " (IPC " << (double) counters.get(PerfCounters::INSTRUCTIONS) / counters.get(PerfCounters::CYCLES) << ")";
+    }
+    cerr << endl;
+}
+
+// expands a pattern into every exact string it matches over the given alphabet
+void expandPattern(const Pattern& pattern, const string& alphabet, string& prefix, vector<string>& patterns) {
+    int i = prefix.size();
+    if (i == pattern.size()) {
+        patterns.push_back(prefix);
+        return;
+    }
+    for (char c: alphabet) {
+        if (pattern.matches(i, c)) {
+            prefix.push_back(c);
+            expandPattern(pattern, alphabet, prefix, patterns);
+            prefix.pop_back();
+        }
+    }
+}
+
 int index(int argc, char* argv[]) {
     // check the command-line arguments
     if (argc < 4) {
@@ -58,12 +267,32 @@ int index(int argc, char* argv[]) {
     }
     string type = argv[2];
     string filename = argv[3];
+    Options options;
+    if (!parseOptions(argc, argv, 4, options) || options.counters) {
+      usageIndex(argc, argv);
+      return 1;
+    }
     CFG* cfg = loadGrammar(type, filename);
     if (cfg == NULL) {
       usageIndex(argc, argv);
       return 1;
     }
-    CDAWG cdawg(cfg);
+    if (options.rebalance) {
+        cfg->rebalance();
+    }
+    CDAWG cdawg(cfg, options.construction, options.edgeMemoryLimit);
+    for (const string& appended: options.appended) {
+        CFG* extra = loadGrammar(type, appended);
+        if (options.rebalance) {
+            extra->rebalance();
+        }
+        chrono::steady_clock::time_point startTime = chrono::steady_clock::now();
+        cdawg.append(extra);
+        chrono::steady_clock::time_point endTime = chrono::steady_clock::now();
+        cerr << "appended " << appended << " (" << extra->getTextLength() << " characters): "
+             << chrono::duration_cast<chrono::milliseconds>(endTime - startTime).count() << "[ms]" << endl;
+        delete extra;
+    }
     // TODO: implement saving CDAWG to file
     return 0;
 }
@@ -86,58 +315,519 @@ int search(int argc, char* argv[]) {
     return 0;
 }
 
+int documents(int argc, char* argv[]) {
+    // check the command-line arguments
+    if (argc < 5) {
+      usageDocuments(argc, argv);
+      return 1;
+    }
+    string type = argv[2];
+    string list = argv[3];
+    string pattern = argv[4];
+
+    // load the grammars in the collection
+    ifstream reader(list);
+    vector<string> filenames;
+    vector<CFG*> cfgs;
+    string filename;
+    while (getline(reader, filename)) {
+        if (filename.empty()) {
+            continue;
+        }
+        CFG* cfg = loadGrammar(type, filename);
+        if (cfg == NULL) {
+          usageDocuments(argc, argv);
+          return 1;
+        }
+        filenames.push_back(filename);
+        cfgs.push_back(cfg);
+    }
+    CFG* cfg = NULL;
+    try {
+        cfg = CFG::fromCollection(cfgs);
+    } catch (const exception& e) {
+        cerr << "cannot build the collection: " << e.what() << endl;
+    }
+    for (CFG* doc: cfgs) {
+        delete doc;
+    }
+    if (cfg == NULL) {
+        return 1;
+    }
+
+    // list the documents
+    CDAWG cdawg(cfg);
+    for (const auto &[d, count]: cdawg.documents(pattern)) {
+        cout << filenames[d] << "\t" << count << endl;
+    }
+    return 0;
+}
+
+int repeats(int argc, char* argv[]) {
+    // check the command-line arguments
+    if (argc < 6) {
+      usageRepeats(argc, argv);
+      return 1;
+    }
+    string type = argv[2];
+    string filename = argv[3];
+    int minLength = stoi(argv[4]);
+    int k = stoi(argv[5]);
+    string order = (argc > 6) ? argv[6] : "frequent";
+    if (order != "frequent" && order != "longest") {
+      usageRepeats(argc, argv);
+      return 1;
+    }
+    CFG* cfg = loadGrammar(type, filename);
+    if (cfg == NULL) {
+      usageRepeats(argc, argv);
+      return 1;
+    }
+
+    // list the repeats, decoding each one's text as it's printed
+    CDAWG cdawg(cfg);
+    for (const auto &[pos, length, count]: cdawg.repeats(minLength, k, order == "longest")) {
+        string repeat;
+        auto it = cfg->cbegin(pos);
+        for (int j = 0; j < length; ++j, ++it) {
+            repeat += (*it == '\n' || *it == '\t') ? ' ' : *it;
+        }
+        cout << count << "\t" << length << "\t" << repeat << endl;
+    }
+    delete cfg;
+    return 0;
+}
+
+int context(int argc, char* argv[]) {
+    // check the command-line arguments
+    if (argc < 6) {
+      usageContext(argc, argv);
+      return 1;
+    }
+    string type = argv[2];
+    string filename = argv[3];
+    int before = stoi(argv[4]);
+    int after = stoi(argv[5]);
+    CFG* cfg = loadGrammar(type, filename);
+    if (cfg == NULL) {
+      usageContext(argc, argv);
+      return 1;
+    }
+
+    // print the context of each position
+    BlockCache cache(cfg);
+    auto print = [&](int pos) {
+        string snippet = cache.extractContext(pos, before, after);
+        replace(snippet.begin(), snippet.end(), '\n', ' ');
+        replace(snippet.begin(), snippet.end(), '\t', ' ');
+        cout << pos << "\t" << snippet << endl;
+    };
+    if (argc > 6) {
+        for (int i = 6; i < argc; i++) {
+            print(stoi(argv[i]));
+        }
+    } else {
+        string line;
+        while (getline(cin, line)) {
+            if (!line.empty()) {
+                print(stoi(line));
+            }
+        }
+    }
+    delete cfg;
+    return 0;
+}
+
+int unique(int argc, char* argv[]) {
+    // check the command-line arguments
+    if (argc < 5) {
+      usageUnique(argc, argv);
+      return 1;
+    }
+    string type = argv[2];
+    string filename = argv[3];
+    int pos = stoi(argv[4]);
+    int length = (argc > 5) ? stoi(argv[5]) : 1;
+    CFG* cfg = loadGrammar(type, filename);
+    if (cfg == NULL) {
+      usageUnique(argc, argv);
+      return 1;
+    }
+    if (pos < 0 || length < 0 || pos > cfg->getTextLength() - length) {
+      cerr << "positions out of bounds" << endl;
+      delete cfg;
+      return 1;
+    }
+
+    // print each position's shortest unique substring
+    CDAWG cdawg(cfg);
+    BlockCache cache(cfg);
+    vector<pair<int, int>> shortest = cdawg.shortestUnique(pos, length);
+    for (int i = 0; i < length; i++) {
+        string substring = cache.extract(shortest[i].first, shortest[i].second);
+        replace(substring.begin(), substring.end(), '\n', ' ');
+        replace(substring.begin(), substring.end(), '\t', ' ');
+        cout << pos + i << "\t" << shortest[i].first << "\t" << shortest[i].second << "\t" << substring << endl;
+    }
+    delete cfg;
+    return 0;
+}
+
+int absent(int argc, char* argv[]) {
+    // check the command-line arguments
+    if (argc < 5) {
+      usageAbsent(argc, argv);
+      return 1;
+    }
+    string type = argv[2];
+    string filename = argv[3];
+    int maxLength = stoi(argv[4]);
+    CFG* cfg = loadGrammar(type, filename);
+    if (cfg == NULL) {
+      usageAbsent(argc, argv);
+      return 1;
+    }
+
+    // list the words by length and then in lexicographic order
+    CDAWG cdawg(cfg);
+    vector<string> words = cdawg.absentWords(maxLength);
+    sort(words.begin(), words.end(), [](const string& a, const string& b) {
+        return make_pair(a.size(), a) < make_pair(b.size(), b);
+    });
+    for (string& word: words) {
+        replace(word.begin(), word.end(), '\n', ' ');
+        replace(word.begin(), word.end(), '\t', ' ');
+        cout << word << endl;
+    }
+    delete cfg;
+    return 0;
+}
+
+// the average time to access a random character of the grammar's text
+double accessTime(const CFG* cfg, int numAccesses) {
+    mt19937 gen(0);
+    uniform_int_distribution<int> distr(0, cfg->getTextLength() - 1);
+    chrono::steady_clock::time_point startTime, endTime;
+    volatile char checksum = 0;
+    startTime = chrono::steady_clock::now();
+    for (int i = 0; i < numAccesses; i++) {
+        checksum = checksum ^ cfg->get(distr(gen));
+    }
+    endTime = chrono::steady_clock::now();
+    return chrono::duration<double, nano>(endTime - startTime).count() / numAccesses;
+}
+
+int balance(int argc, char* argv[]) {
+    // check the command-line arguments
+    if (argc < 4) {
+      usageBalance(argc, argv);
+      return 1;
+    }
+    string type = argv[2];
+    string filename = argv[3];
+    CFG* cfg = loadGrammar(type, filename);
+    if (cfg == NULL) {
+      usageBalance(argc, argv);
+      return 1;
+    }
+
+    // report the grammar before and after rebalancing
+    int numAccesses = 1000000;
+    cout << "before: height " << cfg->getHeight() << ", rules " << cfg->getNumRules();
+    cout << ", size " << cfg->getTotalSize() << ", access " << accessTime(cfg, numAccesses) << "[ns]" << endl;
+    cfg->rebalance();
+    cout << "after: height " << cfg->getHeight() << ", rules " << cfg->getNumRules();
+    cout << ", size " << cfg->getTotalSize() << ", access " << accessTime(cfg, numAccesses) << "[ns]" << endl;
+    delete cfg;
+    return 0;
+}
+
 int benchmark(int argc, char* argv[]) {
     // check the command-line arguments
     if (argc < 4) {
-      cerr << "usage: same as \"index\" command" << endl;
-      usageIndex(argc, argv);
+      usageBenchmark(argc, argv);
       return 1;
     }
 
     // load the grammar
     string type = argv[2];
     string filename = argv[3];
+    Options options;
+    if (!parseOptions(argc, argv, 4, options) ||
+        options.construction != CDAWG::DECODED || !options.appended.empty()) {
+      usageBenchmark(argc, argv);
+      return 1;
+    }
+    size_t edgeMemoryLimit = options.edgeMemoryLimit;
+    // the counters are only opened if they're reported
+    unique_ptr<PerfCounters> counters;
+    if (options.counters) {
+        counters = make_unique<PerfCounters>();
+        if (!counters->available()) {
+            cerr << "hardware counters unavailable (" << counters->getError() << "), reporting times only" << endl;
+            counters.reset();
+        }
+    }
     cerr << "Loading grammar..." << endl;
+    startCounters(counters.get());
     CFG* cfg = loadGrammar(type, filename);
+    stopCounters(counters.get());
     if (cfg == NULL) {
-      cerr << "usage: same as \"index\" command" << endl;
-      usageIndex(argc, argv);
+      usageBenchmark(argc, argv);
       return 1;
     }
+    double textLength = cfg->getTextLength();
+    if (counters) {
+        reportCounters("load", *counters, textLength, "character");
+    }
+    chrono::steady_clock::time_point startTime, endTime;
+    if (options.rebalance) {
+        cerr << "Rebalancing grammar..." << endl;
+        startTime = chrono::steady_clock::now();
+        cfg->rebalance();
+        endTime = chrono::steady_clock::now();
+        cerr << "rebalance time: " << chrono::duration_cast<chrono::milliseconds>(endTime - startTime).count() << "[ms]";
+        cerr << ", height " << cfg->getHeight() << endl;
+    }
 
     // build the CDAWG index
     cerr << "Building CDAWG..." << endl;
-    CDAWG cdawg(cfg);
+    startCounters(counters.get());
+    startTime = chrono::steady_clock::now();
+    CDAWG cdawg(cfg, CDAWG::DECODED, edgeMemoryLimit);
+    endTime = chrono::steady_clock::now();
+    stopCounters(counters.get());
+    cerr << "build time: " << chrono::duration_cast<chrono::milliseconds>(endTime - startTime).count() << "[ms]" << endl;
+    if (counters) {
+        reportCounters("build", *counters, textLength, "character");
+    }
+    if (edgeMemoryLimit > 0) {
+        cerr << "spilled edges: " << cdawg.spilledBytes() << "[B]" << endl;
+    }
+
+    // build it again while decoding the grammar on another thread
+    cerr << "Building pipelined CDAWG..." << endl;
+    startTime = chrono::steady_clock::now();
+    {
+        CDAWG pipelined(cfg, CDAWG::PIPELINED);
+    }
+    endTime = chrono::steady_clock::now();
+    cerr << "pipelined build time: " << chrono::duration_cast<chrono::milliseconds>(endTime - startTime).count() << "[ms]" << endl;
+
+    // build it again by traversing the grammar
+    cerr << "Building CDAWG from the grammar..." << endl;
+    startTime = chrono::steady_clock::now();
+    {
+        CDAWG fromGrammar(cfg, CDAWG::GRAMMAR);
+    }
+    endTime = chrono::steady_clock::now();
+    cerr << "grammar build time: " << chrono::duration_cast<chrono::milliseconds>(endTime - startTime).count() << "[ms]" << endl;
+
+    // encode the CDAWG in its packed form
+    cerr << "Packing CDAWG..." << endl;
+    PackedCDAWG packed(cdawg);
+    cerr << "nodes: " << packed.getNumNodes() << ", edges: " << packed.getNumEdges() << endl;
+    cerr << "CDAWG size: " << cdawg.sizeInBytes() << "[B]" << endl;
+    cerr << "packed CDAWG size: " << packed.sizeInBytes() << "[B]" << endl;
 
     // benchmark
     cerr << "Running benchmarks..." << endl;
-    chrono::steady_clock::time_point startTime, endTime;
-    uint64_t duration = 0;
-    int numQueries = 10, querySize = 1000;
-    char* query = new char[querySize];
+    int numQueries = 20000, maxQuerySize = 40;
     random_device rd;
     mt19937 gen(rd());
-    uniform_int_distribution<uint32_t> distr(0, cfg->getTextLength() - querySize);
-    uint32_t begin, end;
-
+    uniform_int_distribution<int> querySizeDistr(1, maxQuerySize);
+    uniform_int_distribution<uint32_t> distr(0, max(cfg->getTextLength() - maxQuerySize, 0));
+    uint32_t begin;
+    vector<string> queries;
     for (int i = 0; i < numQueries; i++) {
+        string pattern;
+        auto it = cfg->cbegin(distr(gen));
+        for (int j = querySizeDistr(gen); j > 0 && it != cfg->cend(); --j, ++it) {
+            pattern += *it;
+        }
+        queries.push_back(pattern);
+    }
+
+    // each form runs over all of the queries so neither warms the cache for the other
+    int numMatched = 0, numPackedMatched = 0;
+    startTime = chrono::steady_clock::now();
+    for (const string& pattern: queries) {
+        numMatched += cdawg.search(pattern);
+    }
+    endTime = chrono::steady_clock::now();
+    double duration = chrono::duration<double, micro>(endTime - startTime).count();
+
+    startTime = chrono::steady_clock::now();
+    for (const string& pattern: queries) {
+        numPackedMatched += packed.search(pattern);
+    }
+    endTime = chrono::steady_clock::now();
+    double packedDuration = chrono::duration<double, micro>(endTime - startTime).count();
+
+    cerr << "average query time: " << duration / numQueries << "[µs]";
+    cerr << " (" << numQueries << " queries of 1-" << maxQuerySize << " characters)" << endl;
+    cerr << "average packed query time: " << packedDuration / numQueries << "[µs]" << endl;
+    if (numMatched != numPackedMatched) {
+        cerr << "packed results differ" << endl;
+    }
+
+    // benchmark wildcard queries against expanding them into exact queries
+    cerr << "Running wildcard benchmarks..." << endl;
+    set<char> chars;
+    for (auto it = cfg->cbegin(), end = cfg->cend(); it != end; ++it) {
+        chars.insert(*it);
+    }
+    string alphabet(chars.begin(), chars.end());
+    int numWildcardQueries = 1000, wildcardSize = 16, numExpanded = 0;
+    distr = uniform_int_distribution<uint32_t>(0, cfg->getTextLength() - wildcardSize);
+    uniform_int_distribution<int> posDistr(0, wildcardSize - 1);
+    uniform_int_distribution<int> charDistr(0, alphabet.size() - 1);
+    vector<string> wildcards;
+    for (int i = 0; i < numWildcardQueries; i++) {
+        // replace two positions with wildcards and one with a two character class
         begin = distr(gen);
-        end = begin + querySize - 1;
+        vector<string> symbols;
+        auto it = cfg->cbegin(begin);
+        for (int j = 0; j < wildcardSize; ++j, ++it) {
+            symbols.push_back(string("\\") + *it);
+        }
+        symbols[posDistr(gen)] = "?";
+        symbols[posDistr(gen)] = "?";
+        int j = posDistr(gen);
+        if (symbols[j] != "?") {
+            symbols[j] = "[\\" + symbols[j].substr(1) + "\\" + alphabet[charDistr(gen)] + "]";
+        }
+        string wildcard;
+        for (const string& symbol: symbols) {
+            wildcard += symbol;
+        }
+        wildcards.push_back(wildcard);
+    }
+
+    // each side runs over all of the queries so neither warms the cache for the other
+    int numWildcardMatched = 0, numExpandedMatched = 0;
+    startTime = chrono::steady_clock::now();
+    for (const string& wildcard: wildcards) {
+        Pattern pattern(wildcard);
+        numWildcardMatched += cdawg.search(pattern);
+    }
+    endTime = chrono::steady_clock::now();
+    double wildcardDuration = chrono::duration<double, micro>(endTime - startTime).count();
 
-        auto it = cfg->cbegin();
-        for (int j = 0; j < querySize; ++j, ++it) {
-            query[j] = *it;
+    startTime = chrono::steady_clock::now();
+    for (const string& wildcard: wildcards) {
+        Pattern pattern(wildcard);
+        vector<string> patterns;
+        string prefix;
+        expandPattern(pattern, alphabet, prefix, patterns);
+        for (const string& p: patterns) {
+            if (cdawg.search(p)) {
+                numExpandedMatched++;
+                break;
+            }
         }
-        string pattern(query, querySize);
+        numExpanded += patterns.size();
+    }
+    endTime = chrono::steady_clock::now();
+    double expandedDuration = chrono::duration<double, micro>(endTime - startTime).count();
+
+    cerr << "average wildcard query time: " << wildcardDuration / numWildcardQueries << "[µs]" << endl;
+    cerr << "average expanded query time: " << expandedDuration / numWildcardQueries << "[µs]";
+    cerr << " (" << numExpanded / numWildcardQueries << " exact queries)" << endl;
+    if (numWildcardMatched != numExpandedMatched) {
+        cerr << "wildcard results differ" << endl;
+    }
 
+    // benchmark interleaved batches of exact queries against running them one at a time
+    cerr << "Running batch benchmarks..." << endl;
+    int numBatchQueries = 100000, maxBatchQuerySize = 20;
+    vector<string> batch;
+    uniform_int_distribution<int> sizeDistr(1, maxBatchQuerySize);
+    distr = uniform_int_distribution<uint32_t>(0, cfg->getTextLength() - maxBatchQuerySize);
+    for (int i = 0; i < numBatchQueries; i++) {
+        // half of the queries are mutated so they're likely to fail
+        int size = sizeDistr(gen);
+        string pattern;
+        auto it = cfg->cbegin(distr(gen));
+        for (int j = 0; j < size; ++j, ++it) {
+            pattern += *it;
+        }
+        if (i % 2 == 1) {
+            pattern[posDistr(gen) % size] = alphabet[charDistr(gen)];
+        }
+        batch.push_back(pattern);
+    }
+    int numFound = 0;
+    startCounters(counters.get());
+    startTime = chrono::steady_clock::now();
+    for (const string& pattern: batch) {
+        numFound += cdawg.search(pattern);
+    }
+    endTime = chrono::steady_clock::now();
+    stopCounters(counters.get());
+    double sequential = chrono::duration<double>(endTime - startTime).count();
+    cerr << "sequential throughput: " << (int) (numBatchQueries / sequential) << "[queries/s]" << endl;
+    if (counters) {
+        reportCounters("sequential query", *counters, numBatchQueries, "query");
+    }
+    for (int groupSize = 1; groupSize <= 32; groupSize *= 2) {
+        startCounters(counters.get());
         startTime = chrono::steady_clock::now();
-        cdawg.search(pattern);
+        vector<bool> found = cdawg.search(batch, groupSize);
         endTime = chrono::steady_clock::now();
-        duration += chrono::duration_cast<chrono::microseconds>(endTime - startTime).count();
+        stopCounters(counters.get());
+        double interleaved = chrono::duration<double>(endTime - startTime).count();
+        cerr << "group size " << groupSize << " throughput: " << (int) (numBatchQueries / interleaved) << "[queries/s]";
+        cerr << " (" << sequential / interleaved << "x)" << endl;
+        if (counters) {
+            reportCounters("group size " + to_string(groupSize) + " query", *counters, numBatchQueries, "query");
+        }
+        if (count(found.begin(), found.end(), true) != numFound) {
+            cerr << "batch results differ" << endl;
+        }
     }
 
-    cerr << "average query time: " << duration / numQueries << "[µs]" << endl;
-    delete query;
+    // benchmark extracting snippets clustered around a few regions of the text
+    cerr << "Running context benchmarks..." << endl;
+    int numSnippets = 1000, snippetSize = 80, regionSize = 10000;
+    int numRegions = 10;
+    vector<int> positions;
+    distr = uniform_int_distribution<uint32_t>(0, max(cfg->getTextLength() - regionSize, 0));
+    uniform_int_distribution<int> offsetDistr(0, min(regionSize, cfg->getTextLength()) - 1);
+    for (int i = 0; i < numRegions; i++) {
+        begin = distr(gen);
+        for (int j = 0; j < numSnippets / numRegions; j++) {
+            positions.push_back(begin + offsetDistr(gen));
+        }
+    }
+    size_t checksum = 0;
+    startTime = chrono::steady_clock::now();
+    for (int pos: positions) {
+        int first = max(pos - snippetSize / 2, 0);
+        int last = min(pos + snippetSize / 2, cfg->getTextLength());
+        string snippet;
+        auto it = cfg->cbegin(first);
+        for (int j = first; j < last; ++j, ++it) {
+            snippet += *it;
+        }
+        checksum += snippet.size();
+    }
+    endTime = chrono::steady_clock::now();
+    duration = chrono::duration_cast<chrono::microseconds>(endTime - startTime).count();
+    BlockCache cache(cfg);
+    startTime = chrono::steady_clock::now();
+    for (int pos: positions) {
+        checksum -= cache.extractContext(pos, snippetSize / 2, snippetSize / 2).size();
+    }
+    endTime = chrono::steady_clock::now();
+    uint64_t cachedDuration = chrono::duration_cast<chrono::microseconds>(endTime - startTime).count();
+
+    cerr << "average snippet time: " << (double) duration / numSnippets << "[µs]" << endl;
+    cerr << "average cached snippet time: " << (double) cachedDuration / numSnippets << "[µs]";
+    cerr << " (" << cache.getHits() << " hits, " << cache.getMisses() << " misses)" << endl;
+    if (checksum != 0) {
+        cerr << "cached snippets differ" << endl;
+    }
 
     return 0;
 }
@@ -157,6 +847,18 @@ int main(int argc, char* argv[])
         return index(argc, argv);
     } else if (command == "search") {
         return search(argc, argv);
+    } else if (command == "documents") {
+        return documents(argc, argv);
+    } else if (command == "repeats") {
+        return repeats(argc, argv);
+    } else if (command == "context") {
+        return context(argc, argv);
+    } else if (command == "unique") {
+        return unique(argc, argv);
+    } else if (command == "absent") {
+        return absent(argc, argv);
+    } else if (command == "balance") {
+        return balance(argc, argv);
     } else if (command == "benchmark") {
         return benchmark(argc, argv);
     } else {
@@ -0,0 +1,215 @@
+#include <algorithm>
+#include <bit>  // std::popcount
+#include <queue>
+#include <tuple>
+#include <unordered_map>
+#include "cdawg-index/packed_cdawg.hpp"
+
+namespace cdawg_index {
+
+// PackedArray
+
+PackedArray::PackedArray() : length(0), width(1) { }
+
+PackedArray::PackedArray(int length, int width) :
+    length(length),
+    width(width),
+    words(((uint64_t) length * width + WORD_SIZE - 1) / WORD_SIZE, 0)
+{ }
+
+int PackedArray::bitsFor(uint64_t max)
+{
+    return std::max(1, (int) std::bit_width(max));
+}
+
+uint64_t PackedArray::get(int i) const
+{
+    uint64_t bit = (uint64_t) i * width;
+    int w = bit / WORD_SIZE;
+    int offset = bit % WORD_SIZE;
+    uint64_t mask = (width == WORD_SIZE) ? ~((uint64_t) 0) : (((uint64_t) 1) << width) - 1;
+    uint64_t value = words[w] >> offset;
+    // the value continues in the next word
+    if (offset + width > WORD_SIZE) {
+        value |= words[w + 1] << (WORD_SIZE - offset);
+    }
+    return value & mask;
+}
+
+void PackedArray::set(int i, uint64_t value)
+{
+    uint64_t bit = (uint64_t) i * width;
+    int w = bit / WORD_SIZE;
+    int offset = bit % WORD_SIZE;
+    uint64_t mask = (width == WORD_SIZE) ? ~((uint64_t) 0) : (((uint64_t) 1) << width) - 1;
+    value &= mask;
+    words[w] = (words[w] & ~(mask << offset)) | (value << offset);
+    // the value continues in the next word
+    if (offset + width > WORD_SIZE) {
+        int shift = WORD_SIZE - offset;
+        words[w + 1] = (words[w + 1] & ~(mask >> shift)) | (value >> shift);
+    }
+}
+
+// BitVector
+
+BitVector::BitVector() : length(0) { }
+
+BitVector::BitVector(const std::vector<bool>& bits) :
+    length(bits.size()),
+    words((bits.size() + WORD_SIZE - 1) / WORD_SIZE, 0)
+{
+    int ones = 0;
+    for (int i = 0; i < length; i++) {
+        if (bits[i]) {
+            words[i / WORD_SIZE] |= ((uint64_t) 1) << (i % WORD_SIZE);
+            ones++;
+        }
+    }
+    int rank = 0;
+    for (int w = 0; w < (int) words.size(); w++) {
+        int count = std::popcount(words[w]);
+        // sample each word that contains a multiple of SAMPLE_RATE set bits
+        for (int r = (rank + SAMPLE_RATE - 1) / SAMPLE_RATE * SAMPLE_RATE; r < rank + count; r += SAMPLE_RATE) {
+            samples.push_back(w);
+            sampleRanks.push_back(rank);
+        }
+        rank += count;
+    }
+}
+
+/**
+* Select by scanning words from the nearest sample.
+*
+* The set bits are counted a word at a time from the word that contains the
+* closest preceding sampled bit, then the bit is found within the last word.
+*/
+int BitVector::select(int j) const
+{
+    int w = samples[j / SAMPLE_RATE];
+    int rank = sampleRanks[j / SAMPLE_RATE];
+    int count;
+    while (rank + (count = std::popcount(words[w])) <= j) {
+        rank += count;
+        w++;
+    }
+    uint64_t word = words[w];
+    for (; rank < j; rank++) {
+        word &= word - 1;
+    }
+    return w * WORD_SIZE + std::countr_zero(word);
+}
+
+// PackedCDAWG
+
+PackedCDAWG::PackedCDAWG(const CDAWG& cdawg) : cfg(cdawg.cfg)
+{
+    typedef CDAWG::Node Node;
+
+    // number the nodes breadth-first from the source with the sink last
+    std::unordered_map<Node*, int> ids;
+    std::vector<Node*> order;
+    std::queue<Node*> queue;
+    ids[cdawg.source] = 0;
+    order.push_back(cdawg.source);
+    queue.push(cdawg.source);
+    int numEdges = 0;
+    while (!queue.empty()) {
+        Node* n = queue.front();
+        queue.pop();
+        cdawg.enforceMemoryLimit();
+        const CDAWG::Edges& to = cdawg.edges(n);
+        numEdges += to.size();
+        for (const auto &[c, value]: to) {
+            Node* m = std::get<2>(value);
+            if (m != cdawg.sink && !ids.contains(m)) {
+                ids[m] = order.size();
+                order.push_back(m);
+                queue.push(m);
+            }
+        }
+    }
+    sink = order.size();
+    ids[cdawg.sink] = sink;
+    order.push_back(cdawg.sink);
+    numNodes = order.size();
+
+    // gather the edges of each node in order of their first characters
+    int textLength = cdawg.textLength;
+    std::vector<bool> bits;
+    std::vector<std::tuple<int, int, int>> edges;  // (start, length, target)
+    std::vector<std::pair<unsigned char, std::tuple<int, int, Node*>>> out;
+    int maxLength = 0;
+    for (Node* n: order) {
+        bits.push_back(true);
+        cdawg.enforceMemoryLimit();
+        const CDAWG::Edges& to = cdawg.edges(n);
+        out.assign(to.begin(), to.end());
+        std::sort(out.begin(), out.end(), [](const auto& a, const auto& b) {
+            return a.first < b.first;
+        });
+        int k, p;
+        Node* m;
+        for (const auto &[c, value]: out) {
+            std::tie(k, p, m) = value;
+            // edges to the sink end at the end of the text
+            p = std::min(p, textLength - 1);
+            bits.push_back(false);
+            chars.push_back(c);
+            edges.push_back({k, p - k + 1, ids[m]});
+            maxLength = std::max(maxLength, p - k + 1);
+        }
+    }
+    bits.push_back(true);  // marks the end of the last node's edges
+
+    // pack the edges
+    nodes = BitVector(bits);
+    starts = PackedArray(numEdges, PackedArray::bitsFor(std::max(textLength - 1, 0)));
+    lengths = PackedArray(numEdges, PackedArray::bitsFor(maxLength));
+    targets = PackedArray(numEdges, PackedArray::bitsFor(numNodes - 1));
+    for (int e = 0; e < numEdges; e++) {
+        const auto &[k, length, target] = edges[e];
+        starts.set(e, k);
+        lengths.set(e, length);
+        targets.set(e, target);
+    }
+}
+
+size_t PackedCDAWG::sizeInBytes() const
+{
+    return nodes.sizeInBytes() + chars.size() + starts.sizeInBytes() +
+           lengths.sizeInBytes() + targets.sizeInBytes();
+}
+
+bool PackedCDAWG::search(const std::string& pattern) const
+{
+    std::string::size_type i = 0;
+    int n = 0;  // the source
+    while (i < pattern.size() && n != sink) {
+        // the edges of node n are between its set bit and the next one
+        int first = nodes.select(n) - n;
+        int last = nodes.select(n + 1) - n - 1;
+        auto begin = chars.begin() + first, end = chars.begin() + last;
+        auto itr = std::lower_bound(begin, end, (unsigned char) pattern[i]);
+        if (itr == end || *itr != (unsigned char) pattern[i]) {
+            return false;
+        }
+        int e = itr - chars.begin();
+        // the label's first character is the edge's key so it isn't decoded
+        int k = starts.get(e) + 1;
+        int length = lengths.get(e) - 1;
+        i++;
+        if (length > 0 && i < pattern.size()) {
+            auto it = cfg->cbegin(k);
+            for (int j = 0; j < length && i < pattern.size(); ++j, ++i, ++it) {
+                if (pattern[i] != *it) {
+                    return false;
+                }
+            }
+        }
+        n = targets.get(e);
+    }
+    return i == pattern.size();
+}
+
+}
@@ -0,0 +1,118 @@
+#include <bit>  // std::countr_zero
+#include <stdexcept>
+#include "cdawg-index/pattern.hpp"
+
+namespace cdawg_index {
+
+// construction
+
+Pattern::Pattern(const std::string& pattern)
+{
+    std::string::size_type i = 0;
+    while (i < pattern.size()) {
+        CharClass cc = {};
+        char c = pattern[i++];
+        // wildcard
+        if (c == '?') {
+            cc.fill(~((uint64_t) 0));
+        // character class
+        } else if (c == '[') {
+            bool negate = i < pattern.size() && pattern[i] == '^';
+            if (negate) {
+                i++;
+            }
+            bool closed = false;
+            while (i < pattern.size()) {
+                unsigned char lo = pattern[i++];
+                if (lo == ']') {
+                    closed = true;
+                    break;
+                }
+                if (lo == '\\') {
+                    if (i == pattern.size()) {
+                        break;
+                    }
+                    lo = pattern[i++];
+                }
+                unsigned char hi = lo;
+                if (i + 1 < pattern.size() && pattern[i] == '-' && pattern[i + 1] != ']') {
+                    hi = pattern[i + 1];
+                    i += 2;
+                    if (hi == '\\') {
+                        if (i == pattern.size()) {
+                            break;
+                        }
+                        hi = pattern[i++];
+                    }
+                    if (hi < lo) {
+                        throw std::runtime_error("invalid range in character class");
+                    }
+                }
+                for (int u = lo; u <= hi; u++) {
+                    add(cc, u);
+                }
+            }
+            if (!closed) {
+                throw std::runtime_error("unterminated character class");
+            }
+            if (negate) {
+                for (uint64_t& w: cc) {
+                    w = ~w;
+                }
+            }
+        // escaped character
+        } else if (c == '\\') {
+            if (i == pattern.size()) {
+                throw std::runtime_error("trailing escape character");
+            }
+            add(cc, pattern[i++]);
+        // literal character
+        } else {
+            add(cc, c);
+        }
+        classes.push_back(cc);
+    }
+
+    // list the members of each class for probing edges by character
+    members.reserve(classes.size());
+    for (const CharClass& cc: classes) {
+        std::string m;
+        for (int w = 0; w < CLASS_WORDS; w++) {
+            for (uint64_t bits = cc[w]; bits != 0; bits &= bits - 1) {
+                m.push_back((char) (w * WORD_SIZE + std::countr_zero(bits)));
+            }
+        }
+        members.push_back(std::move(m));
+    }
+}
+
+void Pattern::add(CharClass& cc, unsigned char c)
+{
+    cc[c / WORD_SIZE] |= ((uint64_t) 1) << (c % WORD_SIZE);
+}
+
+// matching
+
+/**
+* Tests a whole block without branching on individual characters.
+*
+* Each character selects a word of its position's bit vector and the bit for the
+* character is ANDed into a single accumulator, so the loop has no data-dependent
+* branches. This is a scalar table lookup, not a SIMD test: every position has
+* its own class, so a vector test would need a per-lane 256-bit table lookup,
+* i.e. a gather, which compilers don't generate for this loop and which isn't in
+* the baseline instruction set the project is built for. A shuffle-based nibble
+* lookup only applies when every character is tested against the same class.
+*/
+bool Pattern::matches(int i, const char* block, int length) const
+{
+    uint64_t hit = 1;
+    const CharClass* cc = classes.data() + i;
+    for (int j = 0; j < length; j++) {
+        unsigned char u = (unsigned char) block[j];
+        hit &= cc[j][u / WORD_SIZE] >> (u % WORD_SIZE);
+    }
+    return hit & 1;
+}
+
+}
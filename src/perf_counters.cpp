@@ -0,0 +1,145 @@
+#include "cdawg-index/perf_counters.hpp"
+
+#ifdef __linux__
+#include <cerrno>
+#include <cstring>  // std::strerror
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace cdawg_index {
+
+namespace {
+
+const char* NAMES[PerfCounters::NUM_EVENTS] = {
+    "cycles",
+    "instructions",
+    "L1d misses",
+    "LLC misses",
+    "branch misses",
+    "dTLB misses"
+};
+
+#ifdef __linux__
+
+// the type and config of each event for perf_event_open
+const uint32_t TYPES[PerfCounters::NUM_EVENTS] = {
+    PERF_TYPE_HARDWARE,
+    PERF_TYPE_HARDWARE,
+    PERF_TYPE_HW_CACHE,
+    PERF_TYPE_HW_CACHE,
+    PERF_TYPE_HARDWARE,
+    PERF_TYPE_HW_CACHE
+};
+
+const uint64_t READ_MISS = (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+
+const uint64_t CONFIGS[PerfCounters::NUM_EVENTS] = {
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_L1D | READ_MISS,
+    PERF_COUNT_HW_CACHE_LL | READ_MISS,
+    PERF_COUNT_HW_BRANCH_MISSES,
+    PERF_COUNT_HW_CACHE_DTLB | READ_MISS
+};
+
+#endif
+
+}
+
+// construction
+
+PerfCounters::PerfCounters()
+{
+    for (int e = 0; e < NUM_EVENTS; e++) {
+        fds[e] = -1;
+        values[e] = 0;
+    }
+#ifdef __linux__
+    for (int e = 0; e < NUM_EVENTS; e++) {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = TYPES[e];
+        attr.config = CONFIGS[e];
+        attr.disabled = 1;
+        attr.inherit = 1;  // count threads started later, e.g. the pipelined decoder
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        fds[e] = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        if (fds[e] == -1 && error.empty()) {
+            error = std::string(NAMES[e]) + ": " + std::strerror(errno);
+        }
+    }
+    if (available()) {
+        error.clear();
+    }
+#else
+    error = "perf events are only supported on Linux";
+#endif
+}
+
+PerfCounters::~PerfCounters()
+{
+#ifdef __linux__
+    for (int e = 0; e < NUM_EVENTS; e++) {
+        if (fds[e] != -1) {
+            close(fds[e]);
+        }
+    }
+#endif
+}
+
+// counting
+
+void PerfCounters::start()
+{
+#ifdef __linux__
+    for (int e = 0; e < NUM_EVENTS; e++) {
+        if (fds[e] != -1) {
+            ioctl(fds[e], PERF_EVENT_IOC_RESET, 0);
+            ioctl(fds[e], PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+#endif
+}
+
+void PerfCounters::stop()
+{
+#ifdef __linux__
+    for (int e = 0; e < NUM_EVENTS; e++) {
+        if (fds[e] != -1) {
+            ioctl(fds[e], PERF_EVENT_IOC_DISABLE, 0);
+        }
+    }
+    for (int e = 0; e < NUM_EVENTS; e++) {
+        // the count, the time the event was enabled, and the time it was counted
+        uint64_t data[3];
+        values[e] = 0;
+        if (fds[e] == -1 || read(fds[e], data, sizeof(data)) != sizeof(data) || data[2] == 0) {
+            continue;
+        }
+        values[e] = (data[2] < data[1]) ? (uint64_t) ((double) data[0] * data[1] / data[2]) : data[0];
+    }
+#endif
+}
+
+bool PerfCounters::available() const
+{
+    for (int e = 0; e < NUM_EVENTS; e++) {
+        if (fds[e] != -1) {
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* PerfCounters::getName(Event e)
+{
+    return NAMES[e];
+}
+
+}